@@ -0,0 +1,123 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  align_bench.cpp
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 09:41:13 PM
+ *
+ *    Description:  Microbenchmark of seq_aligner, time per cell of the
+ *    band with accessors of runtime and compile-time direction
+ *
+ *       Revision:  none
+ *
+ * ===========================================================================
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<string>
+#include	<vector>
+#include	<fstream>
+
+#include	"dna_seq.h"
+#include	"seq_aligner.h"
+#include	"common.h"
+
+const char *usage_str = "usage: %s file [engine] [nrepeat]\n"
+    "   Align every pair of sequences in file (e.g. test/real_align.txt)\n"
+    "   nrepeat times (10 by default), in both directions, with seq_accessor\n"
+    "   and with fwd_accessor/rev_accessor, and print the time per cell.\n"
+    "   engine is one of scalar (default), bitvec, sse, avx2, avx512.\n";
+
+std::vector<std::string> refs;
+std::vector<std::string> segs;
+t_aligner *paligner = NULL;
+int nrepeat = 10;
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  now
+ *  Description:  CPU time in seconds
+ * ===========================================================================
+ */
+    double
+now ( )
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}		/* -----  end of function now  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  bench
+ *  Description:  align all the pairs in direction forward with accessors of
+ *  type A, named name, and return the time per cell in nanoseconds
+ * ===========================================================================
+ */
+template <class A>
+    double
+bench ( const char *name, bool forward )
+{
+    size_t ncell = 0;
+    int naligned = 0;
+    double start = now();
+    for (int r = 0; r < nrepeat; ++r) {
+        for (size_t k = 0; k < refs.size(); ++k) {
+            char *pr = (char*)refs[k].c_str()
+                + (forward ? 0 : refs[k].length()-1);
+            char *ps = (char*)segs[k].c_str()
+                + (forward ? 0 : segs[k].length()-1);
+            A ac_ref(pr, forward, refs[k].length());
+            A ac_seg(ps, forward, segs[k].length());
+            if (paligner->align(&ac_seg, &ac_ref) >= 0) ++naligned;
+            ncell += paligner->ncell;
+        }
+    }
+    double elapsed = now() - start;
+    LOG("%s %-12s %d aligned, %lu cells, %.3f ns/cell\n",
+            forward ? "forward " : "backward", name, naligned,
+            (unsigned long)ncell, elapsed * 1e9 / ncell);
+    return elapsed * 1e9 / ncell;
+}		/* -----  end of function bench  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  main
+ *  Description:
+ * ===========================================================================
+ */
+    int
+main ( int argc, char *argv[] )
+{
+    if (argc < 2) {
+        fprintf(stderr, usage_str, argv[0]);
+        return EXIT_FAILURE;
+    }
+    ENGINE engine = ENGINE_SCALAR;
+    if (argc > 2 && (engine = (ENGINE)engine_by_name(argv[2])) == 0) {
+        fprintf(stderr, usage_str, argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3) nrepeat = atoi(argv[3]);
+
+    std::ifstream fin(argv[1]);
+    std::string ref_str, seg_str;
+    while (fin >> ref_str >> seg_str) {
+        refs.push_back(ref_str);
+        segs.push_back(seg_str);
+    }
+    paligner = new t_aligner(MAXR, engine);
+    LOG("engine: %s, %lu pairs, %d times\n", engine_name(engine),
+            (unsigned long)refs.size(), nrepeat);
+
+    for (int dir = 0; dir < 2; ++dir) {
+        double t0 = bench<seq_accessor>("seq_accessor", dir == 0);
+        double t1 = dir == 0 ? bench<fwd_accessor>("fwd_accessor", true)
+            : bench<rev_accessor>("rev_accessor", false);
+        LOG("%s speedup %.2fx\n", dir == 0 ? "forward " : "backward", t0/t1);
+    }
+    delete paligner;
+
+    return EXIT_SUCCESS;
+}				/* ----------  end of function main  ---------- */
@@ -0,0 +1,300 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  batch_engine.h
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 03:26:51 PM
+ *
+ *    Description:  inter-sequence SIMD engine of seq_aligner, aligning a
+ *    batch of pairs at once, one pair per lane
+ *
+ *       Revision:  none
+ *
+ *
+ * ===========================================================================
+ */
+
+#ifndef BATCH_ENGINE_H
+#define BATCH_ENGINE_H
+
+#include	<stdlib.h>
+#include	<algorithm>
+#include	<vector>
+#include	"dna_seq.h"
+#include	"simd_engine.h"
+#include	"common.h"
+
+/**
+ * One pair of batch_engine: seg_a[k][0:la] against seg_b[k][0:lb] with
+ * maximum diagonal distance md, and the goal cell found, cost -1 on early
+ * failure.
+ **/
+typedef struct {
+    int k;
+    int la;
+    int lb;
+    int md;
+    int ma;
+    int mb;
+    int cost;
+} batch_pair;
+
+/**
+ * Inter-sequence SIMD engine of the banded edit distance, score only. Every
+ * lane of a vector holds a different pair, so the whole vector is busy even
+ * if every band is narrow, and the pairs are filled row by row exactly as
+ * the scalar engine does. Cells are stored striped, i.e., the costs of a
+ * cell for all the pairs are contiguous. A lane takes the next pair as soon
+ * as its pair is done or fails, so lanes do not idle behind long pairs.
+ *
+ * Lanes are then on different rows of their pairs. Bases of seg_a are
+ * stored by global row, and bases of seg_b by global row plus diagonal, so
+ * all lanes still read their codes with plain vector loads. Every lane
+ * masks the cells out of its band, or before column 0 of its pair, by
+ * comparing the diagonal with its own bounds.
+ **/
+class batch_engine {
+public:
+    typedef unsigned short t_cost;
+    //! cost of cells outside the band, also the limit of len_a+len_b
+    static const int INF = 0xFFFF;
+    //! widest vector in 16-bit lanes
+    static const int MAX_LANES = 32;
+
+    /**
+     * Number of pairs aligned at once by engine e.
+     **/
+    static int lanes(ENGINE e) {
+        return e == ENGINE_AVX512 ? 32 : (e == ENGINE_AVX2 ? 16 : 8);
+    }
+
+    /**
+     * Align the n pairs of ps, of segments seg_a and seg_b, using the
+     * kernel of engine e, with the early failure and the goal cell of
+     * seq_aligner. Pairs are taken by the lanes in order, and all are
+     * computed as wide as the widest band.
+     **/
+    template <class A, class B>
+    void search(A *seg_a, B *seg_b, batch_pair *ps, int n, double r, 
+            ENGINE e) {
+        row_kernel kernel = get_kernel(e);
+        assert(kernel != NULL);
+        L = lanes(e);
+        MD = 0;
+        for (int k = 0; k < n; ++k) {
+            assert(ps[k].la > 0 && ps[k].lb > 0 && ps[k].la + ps[k].lb < INF);
+            MD = std::max(MD, ps[k].md);
+        }
+        W = 2*MD + 1;
+        rows.assign(2*(W+2)*L, INF);
+        ca.clear();
+        cb.clear();
+        ncell = 0;
+
+        int next = 0, nbusy = 0;
+        for (int l = 0; l < L; ++l) {
+            if (next < n) take(l, next < n ? &ps[next++] : NULL, 0, seg_a, seg_b);
+            if (slot[l]) ++nbusy;
+        }
+        for (int g = 1; nbusy > 0; ++g) {
+            if (ca.size() < (size_t)(g+1)*L) ca.resize((size_t)(g+1)*L, 4);
+            if (cb.size() < (size_t)(g+W)*L) cb.resize((size_t)(g+W)*L, 5);
+            for (int l = 0; l < L; ++l) 
+                if (slot[l]) 
+                    lo[l] = std::max(MD - slot[l]->md, MD - (g - start[l]));
+            kernel(cell(g-1, 0), cell(g, 0), &ca[g*L], &cb[g*L], lo, hi, W);
+            ncell += (size_t)W * L;
+
+            for (int l = 0; l < L; ++l) {
+                batch_pair *p = slot[l];
+                if (!p) continue;
+                int i = g - start[l];
+                // early failure
+                bool fail = i > 10 && i <= p->lb && cell(g, MD)[l] > i*r;
+                if (!fail && p->la > p->lb && i >= p->lb 
+                        && i - p->lb <= p->md) {
+                    t_cost c = cell(g, p->lb - i + MD)[l];
+                    if (i == p->lb || c < best[l]) {
+                        best[l] = c;
+                        p->ma = i;
+                        p->mb = p->lb;
+                    }
+                } else if (!fail && p->la <= p->lb && i == p->la) {
+                    p->ma = p->mb = p->la;
+                    best[l] = cell(g, MD)[l];
+                    int jhi = std::min(p->lb, p->la + p->md);
+                    for (int j = p->la+1; j <= jhi; ++j) {
+                        t_cost c = cell(g, j - i + MD)[l];
+                        if (c < best[l]) {
+                            best[l] = c;
+                            p->mb = j;
+                        }
+                    }
+                }
+                if (!fail && i < p->la) continue;
+                p->cost = fail ? -1 : best[l];
+                take(l, next < n ? &ps[next++] : NULL, g, seg_a, seg_b);
+                if (!slot[l]) --nbusy;
+            }
+        }
+    }
+
+    size_t ncell;               //! cells computed by the last search
+private:
+    /*
+     * Fill n cells of a row for all the lanes from the previous row prev,
+     * the base codes of seg_a on the row and of seg_b on the n cells. Cells
+     * out of diagonals lo to hi of a lane, i.e., out of its band or before
+     * column 0, are masked. cur[-lanes] holds the cell left of the row.
+     */
+    typedef void (*row_kernel)(const t_cost *prev, t_cost *cur,
+            const t_cost *a, const t_cost *b, const short *lo, 
+            const short *hi, int n);
+
+    static row_kernel get_kernel(ENGINE e) {
+#ifdef SIMD_X86
+        if (e == ENGINE_SSE) return row_sse;
+        if (e == ENGINE_AVX2) return row_avx2;
+        if (e == ENGINE_AVX512) return row_avx512;
+#endif
+        return NULL;
+    }
+
+#ifdef SIMD_X86
+    __attribute__((target("sse4.1")))
+    static void row_sse(const t_cost *prev, t_cost *cur,
+            const t_cost *a, const t_cost *b, const short *lo, 
+            const short *hi, int n) {
+        const __m128i one = _mm_set1_epi16(1);
+        __m128i av = _mm_loadu_si128((const __m128i*)a);
+        __m128i lv = _mm_loadu_si128((const __m128i*)lo);
+        __m128i hv = _mm_loadu_si128((const __m128i*)hi);
+        __m128i left = _mm_loadu_si128((const __m128i*)(cur-8));
+        __m128i d = _mm_loadu_si128((const __m128i*)prev);
+        __m128i kv = _mm_setzero_si128();
+        for (int t = 0; t < n; ++t, prev += 8, cur += 8, b += 8) {
+            __m128i u = _mm_loadu_si128((const __m128i*)(prev+8));
+            __m128i k = _mm_or_si128(_mm_cmpgt_epi16(lv, kv),
+                    _mm_cmpgt_epi16(kv, hv));
+            __m128i m = _mm_andnot_si128(_mm_cmpeq_epi16(av,
+                        _mm_loadu_si128((const __m128i*)b)), one);
+            __m128i x = _mm_or_si128(_mm_min_epu16(_mm_adds_epu16(d, m),
+                        _mm_adds_epu16(u, one)), k);
+            // masked lanes saturate, keeping the insertion chain short
+            left = _mm_min_epu16(x, _mm_adds_epu16(left, _mm_or_si128(k, one)));
+            _mm_storeu_si128((__m128i*)cur, left);
+            kv = _mm_add_epi16(kv, one);
+            d = u;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void row_avx2(const t_cost *prev, t_cost *cur,
+            const t_cost *a, const t_cost *b, const short *lo, 
+            const short *hi, int n) {
+        const __m256i one = _mm256_set1_epi16(1);
+        __m256i av = _mm256_loadu_si256((const __m256i*)a);
+        __m256i lv = _mm256_loadu_si256((const __m256i*)lo);
+        __m256i hv = _mm256_loadu_si256((const __m256i*)hi);
+        __m256i left = _mm256_loadu_si256((const __m256i*)(cur-16));
+        __m256i d = _mm256_loadu_si256((const __m256i*)prev);
+        __m256i kv = _mm256_setzero_si256();
+        for (int t = 0; t < n; ++t, prev += 16, cur += 16, b += 16) {
+            __m256i u = _mm256_loadu_si256((const __m256i*)(prev+16));
+            __m256i k = _mm256_or_si256(_mm256_cmpgt_epi16(lv, kv),
+                    _mm256_cmpgt_epi16(kv, hv));
+            __m256i m = _mm256_andnot_si256(_mm256_cmpeq_epi16(av,
+                        _mm256_loadu_si256((const __m256i*)b)), one);
+            __m256i x = _mm256_or_si256(_mm256_min_epu16(
+                        _mm256_adds_epu16(d, m), _mm256_adds_epu16(u, one)), k);
+            left = _mm256_min_epu16(x, 
+                    _mm256_adds_epu16(left, _mm256_or_si256(k, one)));
+            _mm256_storeu_si256((__m256i*)cur, left);
+            kv = _mm256_add_epi16(kv, one);
+            d = u;
+        }
+    }
+
+    __attribute__((target("avx512bw")))
+    static void row_avx512(const t_cost *prev, t_cost *cur,
+            const t_cost *a, const t_cost *b, const short *lo, 
+            const short *hi, int n) {
+        const __m512i one = _mm512_set1_epi16(1);
+        const __m512i inf = _mm512_set1_epi16(-1);
+        __m512i av = _mm512_loadu_si512((const void*)a);
+        __m512i lv = _mm512_loadu_si512((const void*)lo);
+        __m512i hv = _mm512_loadu_si512((const void*)hi);
+        __m512i left = _mm512_loadu_si512((const void*)(cur-32));
+        __m512i d = _mm512_loadu_si512((const void*)prev);
+        __m512i kv = _mm512_setzero_si512();
+        for (int t = 0; t < n; ++t, prev += 32, cur += 32, b += 32) {
+            __m512i u = _mm512_loadu_si512((const void*)(prev+32));
+            __mmask32 k = _mm512_cmpgt_epi16_mask(lv, kv) 
+                | _mm512_cmpgt_epi16_mask(kv, hv);
+            __m512i m = _mm512_maskz_mov_epi16(_mm512_cmpneq_epi16_mask(av,
+                        _mm512_loadu_si512((const void*)b)), one);
+            __m512i x = _mm512_mask_mov_epi16(_mm512_min_epu16(
+                        _mm512_adds_epu16(d, m), _mm512_adds_epu16(u, one)), 
+                    k, inf);
+            left = _mm512_mask_mov_epi16(_mm512_min_epu16(x, 
+                        _mm512_adds_epu16(left, one)), k, inf);
+            _mm512_storeu_si512((void*)cur, left);
+            kv = _mm512_add_epi16(kv, one);
+            d = u;
+        }
+    }
+#endif
+
+    /*
+     * Lane l takes pair p, NULL for none, on global row g: its band,
+     * its row 0 and the codes of its bases. 
+     */
+    template <class A, class B>
+    void take(int l, batch_pair *p, int g, A *seg_a, B *seg_b) {
+        slot[l] = p;
+        start[l] = g;
+        best[l] = INF;
+        hi[l] = p ? MD + p->md : -1;
+        for (int t = 0; t < W; ++t) {
+            bool in = p && abs(t - MD) <= p->md;
+            cell(g, t)[l] = in && t >= MD ? t - MD : INF;
+        }
+        if (!p) return;
+        if (ca.size() < (size_t)(g+p->la+1)*L) 
+            ca.resize((size_t)(g+p->la+1)*L, 4);
+        if (cb.size() < (size_t)(g+MD+p->lb+1)*L) 
+            cb.resize((size_t)(g+MD+p->lb+1)*L, 5);
+        A *pa = &seg_a[p->k];
+        B *pb = &seg_b[p->k];
+        pa->reset(0);
+        for (int i = 1; i <= p->la; ++i) {
+            char c = pa->next();
+            ca[(g+i)*L+l] = C2I(c);
+        }
+        pb->reset(0);
+        for (int j = 1; j <= p->lb; ++j) {
+            char d = pb->next();
+            cb[(g+MD+j)*L+l] = C2I(d);
+        }
+        p->cost = -1;
+    }
+
+    // lanes of cell k, -1 to W, on global row g
+    t_cost* cell(int g, int k) {
+        return &rows[((g&1)*(W+2) + k+1) * L];
+    }
+
+    int L;                      // lanes of the kernel
+    int MD;                     // widest max_dst of the batch
+    int W;                      // width of the band, 2*MD+1
+    batch_pair *slot[MAX_LANES];    // pair of every lane, NULL for none
+    int start[MAX_LANES];       // global row of row 0 of the pair
+    short lo[MAX_LANES];        // first diagonal of the band on the row
+    short hi[MAX_LANES];        // last diagonal of the band
+    t_cost best[MAX_LANES];     // best cost at the goal so far
+    std::vector<t_cost> rows;   // two rolling rows, striped
+    std::vector<t_cost> ca;     // codes of seg_a by row, padded with 4
+    std::vector<t_cost> cb;     // codes of seg_b by row+diagonal, or 5
+};
+
+#endif
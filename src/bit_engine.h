@@ -0,0 +1,282 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  bit_engine.h
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 09:12:40 AM
+ *
+ *    Description:  bit-parallel banded edit distance engine of seq_aligner
+ *
+ *       Revision:  none
+ *
+ *
+ * ===========================================================================
+ */
+
+#ifndef BIT_ENGINE_H
+#define BIT_ENGINE_H
+
+#include	<limits.h>
+#include	<algorithm>
+#include	<vector>
+#include	"dna_seq.h"
+#include	"common.h"
+
+/**
+ * Bit-parallel engine of the banded edit distance (Myers' algorithm with
+ * Hyyro's block decomposition). The bases of seg_b are packed into 64-bit
+ * words (blocks), and every base of seg_a advances all the blocks touched
+ * by the band with a few bitwise operations, so 64 cells of the DP are
+ * computed at once. Vertical deltas of every stored block are kept, thus
+ * the cost of any cell inside the band can be recovered by popcount, which
+ * is what the traceback in seq_aligner needs.
+ *
+ * In score-only mode no block is stored, only the costs of the last row and
+ * the last column are kept, which is all the goal cell needs.
+ *
+ * With an X-drop, the band is adaptive: it only keeps the blocks that may
+ * hold a cell within X of the best one of the column, which is usually a
+ * few blocks around the true alignment path instead of the whole band.
+ *
+ * Blocks leaving the top of the band are retired, and the horizontal delta
+ * entering the topmost live block is assumed to be +1 (a deletion from the
+ * previous column). Blocks entering the bottom of the band start with +1
+ * vertical deltas. Both assumptions describe real alignment paths, so every
+ * cost is achievable and never larger than the one of the scalar band.
+ **/
+class bit_engine {
+public:
+    typedef unsigned long long t_word;
+    size_t ncell;               //! cells computed by the last search
+
+    /**
+     * Compute the band of seg_a[0:la] against seg_b[0:lb] with maximum
+     * diagonal distance md. Return false on early failure, i.e., the cost
+     * on the main diagonal exceeds ratio r of its length. Blocks are stored
+     * for the traceback only if store is set. If xd is not 0, the band is
+     * adaptive: blocks whose cells all cost more than xd above the best
+     * cell of the column are dropped, and the early failure looks at the
+     * best cell of the column instead of the main diagonal. 
+     **/
+    template <class A, class B>
+    bool search(A *seg_a, B *seg_b, int la, int lb,
+            int md, double r, int xd = 0, bool store = true) {
+        len_a = la;
+        len_b = lb;
+        max_dst = md;
+        stored = store || len_b == 0;
+        ncell = 0;
+        if (len_b == 0) {
+            col_lo.assign(len_a+1, 0);
+            col_hi.assign(len_a+1, -1);
+            col_off.assign(len_a+1, 0);
+            return true;
+        }
+
+        int nblock = (len_b + WORD_LEN - 1) / WORD_LEN;
+        peq.assign(nblock * 4, 0);
+        for (int j = 0; j < len_b; ++j) {
+            char d = seg_b->at(j);
+            peq[(j/WORD_LEN)*4 + C2I(d)] |= (t_word)1 << (j%WORD_LEN);
+        }
+
+        col_lo.resize(len_a+1);
+        col_hi.resize(len_a+1);
+        col_off.resize(len_a+1);
+        if (stored) {
+            cols.resize((size_t)(len_a+1) * ((2*max_dst+1)/WORD_LEN + 2));
+        } else {
+            last_row.resize(len_b+1);
+            last_col.resize(len_a+1);
+        }
+        work.resize(nblock);
+
+        // column 0: D(0, j) = j
+        int lo = 0;
+        int hi = (std::min(len_b, std::min(max_dst, xd ? xd : len_b)) - 1) 
+            / WORD_LEN;
+        for (int b = 0; b <= hi; ++b) {
+            work[b].pv = ~(t_word)0;
+            work[b].mv = 0;
+            work[b].score = (b+1) * WORD_LEN;
+        }
+        col_lo[0] = 0;
+        col_hi[0] = hi;
+        col_off[0] = 0;
+
+        size_t off = 0;
+        int best = 0;
+        seg_a->reset(0);
+        for (int i = 1; i <= len_a; ++i) {
+            char a = seg_a->next();
+            int c = C2I(a);
+            int blo = (std::max(1, i - max_dst) - 1) / WORD_LEN;
+            int bhi = (std::min(len_b, i + max_dst) - 1) / WORD_LEN;
+            if (xd) {
+                // drop the blocks out of reach at both ends, and only grow
+                // the bottom if its last cell is still in reach
+                int thr = best + xd;
+                int top = lo;
+                while (top < hi && lower_cost(work[top]) > thr) ++top;
+                while (hi > top && lower_cost(work[hi]) > thr) --hi;
+                blo = std::max(blo, top);
+                if (work[hi].score > thr) bhi = std::min(bhi, hi);
+                bhi = std::max(bhi, blo);
+            }
+            while (hi < bhi) {      // block entering the band
+                ++hi;
+                work[hi].pv = ~(t_word)0;
+                work[hi].mv = 0;
+                work[hi].score = work[hi-1].score + WORD_LEN;
+            }
+            while (lo < blo) {      // block leaving the band
+                if (!stored) retire(lo, i-1);
+                ++lo;
+            }
+            col_lo[i] = blo;
+            col_hi[i] = bhi;
+            col_off[i] = off;
+            ncell += (size_t)(bhi - blo + 1) * WORD_LEN;
+            int h = 1;
+            const t_word *eq = &peq[c];
+            best = INT_MAX;
+            for (int b = blo; b <= bhi; ++b) {
+                h = advance(work[b], eq[b*4], h);
+                work[b].score += h;
+                best = std::min(best, work[b].score);
+            }
+            if (stored) {
+                std::copy(&work[blo], &work[bhi]+1, &cols[off]);
+                off += bhi - blo + 1;
+            } else if (len_b <= i + max_dst) {
+                last_col[i] = len_b <= blo*WORD_LEN ? last_col[i-1] + 1 
+                    : bottom_cost(len_b, bhi);
+            }
+            // early failure
+            if (i > 10 && i <= len_b && (xd ? best > i*r 
+                        && work_cost(std::min(std::max(i, blo*WORD_LEN+1), 
+                                std::min(len_b, (bhi+1)*WORD_LEN))) > i*r
+                        && min_cost(blo, bhi) > i*r
+                        : work_cost(i) > i*r))
+                return false;
+        }
+        if (!stored) {
+            for (int j = std::max(lo*WORD_LEN+1, len_a - max_dst); 
+                    j <= len_b; ++j)
+                last_row[j] = bottom_cost(j, hi);
+        }
+        return true;
+    }
+
+    /**
+     * Cost of aligning seg_a[0:i] with seg_b[0:j]. Cells outside the stored
+     * blocks are completed with the boundary assumptions of search. In
+     * score-only mode, only the last row and column are available.
+     **/
+    int get_cost(int i, int j) {
+        if (!stored) return i == len_a ? last_row[j] : last_col[i];
+        int add = 0;
+        while (i > 0 && j <= col_lo[i] * WORD_LEN) {
+            ++add;
+            --i;
+        }
+        if (i == 0) return add + j;
+        if (j == 0) return add + i;
+        int bottom = std::min(len_b, (col_hi[i]+1) * WORD_LEN);
+        if (j > bottom)
+            return add + stored_cost(i, bottom) + j - bottom;
+        return add + stored_cost(i, j);
+    }
+private:
+    static const int WORD_LEN = 64;
+    static const t_word HIGH = (t_word)1 << (WORD_LEN-1);
+
+    // block of 64 vertical deltas and the cost at its last row
+    typedef struct {
+        t_word pv;
+        t_word mv;
+        int score;
+    } block;
+
+    /*
+     * Advance one block by one column, hin is the horizontal delta entering
+     * from above. Return the horizontal delta leaving at the bottom.
+     */
+    static int advance(block &blk, t_word eq, int hin) {
+        t_word pv = blk.pv, mv = blk.mv;
+        t_word xv = eq | mv;
+        if (hin < 0) eq |= 1;
+        t_word xh = (((eq & pv) + pv) ^ pv) | eq;
+        t_word ph = mv | ~(xh | pv);
+        t_word mh = pv & xh;
+        int hout = (ph & HIGH) ? 1 : ((mh & HIGH) ? -1 : 0);
+        ph <<= 1;
+        mh <<= 1;
+        if (hin < 0) mh |= 1;
+        else if (hin > 0) ph |= 1;
+        blk.pv = mh | ~(xv | ph);
+        blk.mv = ph & xv;
+        return hout;
+    }
+
+    // lower bound of the costs in a block
+    static int lower_cost(const block &blk) {
+        return blk.score - __builtin_popcountll(blk.pv);
+    }
+
+    // exact best cost of blocks lo to hi of the current column
+    int min_cost(int lo, int hi) {
+        int best = INT_MAX;
+        for (int j = lo*WORD_LEN + 1; j <= std::min(len_b, (hi+1)*WORD_LEN); 
+                ++j)
+            best = std::min(best, work_cost(j));
+        return best;
+    }
+
+    // cost at row j of the current column, completed below the last block
+    int bottom_cost(int j, int hi) {
+        int bottom = std::min(len_b, (hi+1) * WORD_LEN);
+        return j > bottom ? work_cost(bottom) + j - bottom : work_cost(j);
+    }
+
+    /*
+     * Score-only: block b leaves the band after column i, keep its cells on
+     * the last row, which are then reached by deletions only. 
+     */
+    void retire(int b, int i) {
+        int j = std::max(b*WORD_LEN + 1, len_a - max_dst);
+        for (; j <= std::min(len_b, (b+1)*WORD_LEN); ++j)
+            last_row[j] = block_cost(work[b], j) + len_a - i;
+    }
+
+    int stored_cost(int i, int j) {
+        return block_cost(cols[col_off[i] + (j-1)/WORD_LEN - col_lo[i]], j);
+    }
+
+    // cost at row j of the current column, j in the band
+    int work_cost(int j) { return block_cost(work[(j-1)/WORD_LEN], j); }
+
+    // cost at row j of the block holding it
+    static int block_cost(const block &blk, int j) {
+        int bit = (j-1) % WORD_LEN;
+        if (bit == WORD_LEN-1) return blk.score;
+        t_word below = ~(t_word)0 << (bit+1);
+        return blk.score - __builtin_popcountll(blk.pv & below)
+            + __builtin_popcountll(blk.mv & below);
+    }
+
+    int len_a;
+    int len_b;
+    int max_dst;
+    bool stored;                    // blocks stored for the traceback
+    std::vector<t_word> peq;        // match masks, 4 words per block
+    std::vector<block> work;        // blocks of the current column
+    std::vector<block> cols;        // stored blocks of all columns
+    std::vector<size_t> col_off;    // offset of column i into cols
+    std::vector<int> col_lo;        // first block of column i
+    std::vector<int> col_hi;        // last block of column i
+    std::vector<int> last_row;      // score-only: cost at (len_a, j)
+    std::vector<int> last_col;      // score-only: cost at (i, len_b)
+};
+
+#endif
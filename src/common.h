@@ -15,7 +15,6 @@
 #ifndef COMMON_H
 #define COMMON_H
 
-#include	<ext/hash_map>
 #include	<algorithm>
 #include	<list>
 
@@ -28,34 +27,48 @@
 #endif
 
 //! max length of genome allowed
+#ifndef MAX_SEQ_LEN
 #define MAX_SEQ_LEN 800000
-//! max length of segment reads processed
+#endif
+//! length of the two ends of the reference seeded for overlapping reads
 #define MAX_READ_LEN 20000
-//! max difference (distance) allowed between overlapped reads
-#define MAX_DIFF_LEN 6000
 //! max ratio of difference (distance)
 #define MAXR 0.3
 //! min length of aligned region to justify overlap
 #define OVERLAP_MIN 64
+//! min length of reads aligned piecewise between seed hits
+#define CHAIN_MIN_LEN 1024
 
 /**
- * Typedef for a seed for alignment.  
+ * Enum of engine filling the DP band of seq_aligner. 
+ */
+enum ENGINE {
+    ENGINE_SCALAR = 1,  //!< Cell-by-cell reference DP. 
+    ENGINE_BITVEC,      //!< Bit-parallel DP, 64 cells per word. 
+    ENGINE_SSE,         //!< Anti-diagonal DP, 8 16-bit lanes (SSE4.1). 
+    ENGINE_AVX2,        //!< Anti-diagonal DP, 16 16-bit lanes (AVX2). 
+    ENGINE_AVX512       //!< Anti-diagonal DP, 32 16-bit lanes (AVX-512BW). 
+};
+
+//! bits of a seed, 32 (seeds of 16 bases) or 64 (seeds of 32 bases)
+#ifndef SEED_BITS
+#define SEED_BITS 32
+#endif
+
+/**
+ * Typedef for a seed for alignment, 2 bits per base. 
  **/
+#if SEED_BITS == 64
+typedef unsigned long long t_seed;
+#elif SEED_BITS == 32
 typedef unsigned t_seed;
+#else
+#error "SEED_BITS must be 32 or 64"
+#endif
 
 /**
  * Typedef for binary DNA sequence. 
  **/
 typedef unsigned char t_bseq;
 
-/**
- * Hash table used as seedmap. 
- **/
-typedef __gnu_cxx::hash_map< unsigned, std::list<int> > hash_table;
-
-/**
- * Iterator on seedmap.
- * */
-typedef __gnu_cxx::hash_map< unsigned, std::list<int> >::iterator sm_it;
-
 #endif
@@ -0,0 +1,138 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  consensus_bench.cpp
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 11:52:06 PM
+ *
+ *    Description:  Microbenchmark of the consensus of ref_seq, time of
+ *    elect per alignment and of evolve, at references of 100 kb, 1 Mb and
+ *    5 Mb, with votes cast at once and in batch
+ *
+ *       Revision:  none
+ *
+ * ===========================================================================
+ */
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<string.h>
+#include	<time.h>
+#include	<vector>
+
+#include	"ref_seq.h"
+#include	"common.h"
+
+const char *usage_str = "usage: %s [nalign] [alen]\n"
+    "   Vote nalign (10000 by default) random alignments of alen bases\n"
+    "   (1000 by default), half of them backward, at random places of\n"
+    "   random references of 100 kb, 1 Mb and 5 Mb, evolve them, and print\n"
+    "   the time per alignment and per evolve, with votes cast at once and\n"
+    "   in batch at evolve.\n";
+
+const int ref_lens[] = {100000, 1000000, 5000000};
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  now
+ *  Description:  CPU time in seconds
+ * ===========================================================================
+ */
+    double
+now ( )
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}		/* -----  end of function now  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  random_edits
+ *  Description:  edits of an alignment covering len bases of the reference
+ *  ref from pos in direction forward, with about 10% of errors, not
+ *  starting with INSERT
+ * ===========================================================================
+ */
+    void
+random_edits ( std::vector<edit> &edits, const std::vector<char> &ref, 
+        int pos, int len, bool forward )
+{
+    edits.clear();
+    for (int k = 0; k < len; ) {
+        int r = rand() % 100;
+        edit e = {MATCH, ref[forward ? pos+k : pos-k]};
+        if (r < 3 && k > 0)
+            e.op = INSERT;
+        else if (r < 6)
+            e.op = DELETE;
+        if (e.op == INSERT || r < 9) e.val = codes[rand() & 0x3];
+        if (e.op != INSERT) ++k;
+        edits.push_back(e);
+    }
+}		/* -----  end of function random_edits  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  bench
+ *  Description:  elect nalign random alignments of alen bases to a random
+ *  reference of len bases, and evolve it, with votes in batch if batch
+ * ===========================================================================
+ */
+    void
+bench ( int len, int nalign, int alen, bool batch )
+{
+    std::vector<char> txt(len);
+    for (int i = 0; i < len; ++i) txt[i] = codes[rand() & 0x3];
+    ref_seq *pref = new ref_seq(&txt[0], len, false);
+    pref->batch_votes(batch);
+
+    std::vector<std::vector<edit> > alns(nalign);
+    std::vector<int> poss(nalign);
+    for (int a = 0; a < nalign; ++a) {
+        // forward from pos on, or backward from pos down
+        bool forward = !(a & 1);
+        poss[a] = forward ? rand() % (len-alen+1)
+            : alen-1 + rand() % (len-alen+1);
+        random_edits(alns[a], txt, poss[a], alen, forward);
+    }
+
+    double start = now();
+    for (int a = 0; a < nalign; ++a)
+        pref->elect(poss[a], &alns[a][0], alns[a].size(), !(a & 1));
+    double elect_time = now() - start;
+
+    start = now();
+    pref->evolve();
+    double evolve_time = now() - start;
+
+    LOG("%8d bases, %s: elect %.3f us/alignment, evolve %.3f ms, "
+            "%u bases after\n", len, batch ? "batch" : "once ", 
+            elect_time * 1e6 / nalign, evolve_time * 1e3, pref->length());
+    delete pref;
+}		/* -----  end of function bench  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  main
+ *  Description:
+ * ===========================================================================
+ */
+    int
+main ( int argc, char *argv[] )
+{
+    int nalign = argc > 1 ? atoi(argv[1]) : 10000;
+    int alen = argc > 2 ? atoi(argv[2]) : 1000;
+    if (nalign <= 0 || alen <= 0 || alen > ref_lens[0]) {
+        fprintf(stderr, usage_str, argv[0]);
+        return EXIT_FAILURE;
+    }
+    LOG("%d alignments of %d bases\n", nalign, alen);
+    for (size_t k = 0; k < sizeof(ref_lens)/sizeof(ref_lens[0]); ++k) {
+        // the same alignments both ways
+        for (int batch = 0; batch < 2; ++batch) {
+            srand(7 + k);
+            bench(ref_lens[k], nalign, alen, batch);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}				/* ----------  end of function main  ---------- */
@@ -22,8 +22,8 @@
 //! convert binary number to DNA base
 #define I2C(x) ((x == 0) ? 'A' : ((x == 1) ? 'C' : (x == 2 ? 'G' : 'T')))
 
-//! number of DNA bases in a word
-#define N_SEQ_WORD 16
+//! number of DNA bases in a seed
+#define N_SEQ_WORD (SEED_BITS/2)
 //! number of DNA bases in a byte
 #define N_SEQ_BYTE 4
 
@@ -40,6 +40,106 @@ struct txt_seq {
     char *data;
 };
 
+/**
+ * Bases of a text sequence as 2-bit codes, the source of a seed_iterator. 
+ **/
+class txt_bases {
+public:
+    txt_bases(const char *p) : ptext(p) {};
+
+    /**
+     * Same as C2I(ptext[i]), but the code of A, C, G and T is taken from
+     * bits 1 and 2 of the character, without a chain of branches. 
+     **/
+    unsigned code(int i) const { 
+        char c = ptext[i];
+        unsigned v = ((c >> 1) ^ (c >> 2)) & 0x3;
+        return c == codes[v] ? v : 3;
+    };
+private:
+    const char *ptext;
+};
+
+/**
+ * Bases of a binary sequence (t_bseq, with its length header) as 2-bit
+ * codes, the source of a seed_iterator. 
+ **/
+class bin_bases {
+public:
+    bin_bases(const t_bseq *pbin) : pdata(pbin + sizeof(unsigned)) {};
+    unsigned code(int i) const { 
+        return (pdata[i >> 2] >> ((~i & 0x3) << 1)) & 0x3; 
+    };
+private:
+    const t_bseq *pdata;
+};
+
+/**
+ * Reverse the bytes of seed sd, between the layout of seeds in memory (see
+ * dna_seq::encode) and the one with the first base on top. 
+ **/
+inline t_seed swap_seed(t_seed sd) {
+#if SEED_BITS == 64
+    return __builtin_bswap64(sd);
+#else
+    return __builtin_bswap32(sd);
+#endif
+}
+
+/**
+ * Iterator over the seeds of consecutive windows of N_SEQ_WORD bases, from
+ * the one at pos, towards the end of the sequence if DIR is 1 or towards
+ * its beginning if DIR is -1. The window is kept with its first base on
+ * top, and rolled by one base per seed with a shift and an or, instead of
+ * being encoded again (see dna_seq::encode and dna_seq::seed_at); only the
+ * byte order of the seed layout (x86) is fixed on the way out. B is
+ * txt_bases or bin_bases. No base out of the windows visited is read. 
+ **/
+template <class B, int DIR>
+class seed_iterator {
+public:
+    seed_iterator(const B &b, int pos) : bases(b), cur(pos), win(0) {
+        // the N_SEQ_WORD-1 bases shared with the first window
+        for (int i = 0; i < N_SEQ_WORD-1; ++i)
+            win = (win << 2) | bases.code(pos + i + (DIR > 0 ? 0 : 1));
+        if (DIR < 0) win <<= 2;
+    };
+
+    /**
+     * Position of the window of the next seed. 
+     **/
+    int pos() const { return cur; };
+
+    /**
+     * Return the seed of the next window and move on. 
+     **/
+    t_seed next() {
+        if (DIR > 0) {
+            win = (win << 2) | bases.code(cur + N_SEQ_WORD-1);
+        } else {
+            win = (win >> 2) | ((t_seed)bases.code(cur) << (SEED_BITS-2));
+        }
+        cur += DIR;
+        return swap_seed(win);
+    };
+
+    /**
+     * Write the seeds of the next n windows into out. 
+     **/
+    void fill(t_seed *out, int n) {
+        for (int i = 0; i < n; ++i) out[i] = next();
+    };
+private:
+    B bases;
+    int cur;
+    t_seed win;     // bases of the window, the first one on top
+};
+
+typedef seed_iterator<txt_bases, 1> fwd_txt_seeds;
+typedef seed_iterator<txt_bases, -1> rev_txt_seeds;
+typedef seed_iterator<bin_bases, 1> fwd_bin_seeds;
+typedef seed_iterator<bin_bases, -1> rev_bin_seeds;
+
 /**
  * Represents a DNA sequence. It is most used for its static functions
  * because in our progrom a DNA sequence is either a char pointer (text) or
@@ -60,19 +160,28 @@ public:
      * Return the seed at 'pos' of binary sequence pbin. 
      **/
     static t_seed seed_at(unsigned char *pbin, int pos) {
-        pbin += sizeof(unsigned);
-        if ((pos & 0x3) == 0) return *((unsigned*)(pbin+pos));
+        pbin += sizeof(unsigned) + (pos >> 2);
+        if ((pos & 0x3) == 0) return *((t_seed*)pbin);
 
-        unsigned char pseed[4];
-        pbin += (pos >> 2);
+        t_seed sd;
+        unsigned char *pseed = (unsigned char*)&sd;
         unsigned ls = (pos & 0x3) << 1;
         unsigned rs = 0x8 - ls;
-        pseed[0] = (*pbin << ls) | (*++pbin >> rs);
-        pseed[1] = (*pbin << ls) | (*++pbin >> rs);
-        pseed[2] = (*pbin << ls) | (*++pbin >> rs);
-        pseed[3] = (*pbin << ls) | (*++pbin >> rs);
+        for (size_t i = 0; i < sizeof(t_seed); ++i)
+            pseed[i] = (pbin[i] << ls) | (pbin[i+1] >> rs);
+
+        return sd;
+    }
 
-        return *((unsigned*)pseed);
+    /**
+     * Write all the seeds of binary sequence pbin, the one at every
+     * position, into out. Return the number of seeds. 
+     **/
+    static int seeds(const t_bseq *pbin, t_seed *out) {
+        int n = (int)*((const unsigned*)pbin) - N_SEQ_WORD + 1;
+        if (n <= 0) return 0;
+        fwd_bin_seeds(bin_bases(pbin), 0).fill(out, n);
+        return n;
     }
 
     static char value_at(unsigned char bv, int idx) {
@@ -81,16 +190,15 @@ public:
 
     /**
      * Return the seed pointed by ptext, which is supposed to be at least
-     * 16-character-long. 
+     * N_SEQ_WORD-character-long. Byte k of the seed in memory holds bases
+     * 4k to 4k+3, the first one in its highest bits. 
      */
-    static unsigned encode(const char *ptext) {
-        unsigned tseg = 0;
+    static t_seed encode(const char *ptext) {
+        t_seed tseg = 0;
         unsigned char *t = (unsigned char*)&tseg;
 
-        t[0] = t2b(ptext, 4);
-        t[1] = t2b(ptext+4, 4);
-        t[2] = t2b(ptext+8, 4);
-        t[3] = t2b(ptext+12, 4);
+        for (size_t k = 0; k < sizeof(t_seed); ++k)
+            t[k] = t2b(ptext + 4*k, 4);
 
         return tseg;
     };
@@ -98,12 +206,10 @@ public:
     /**
      * Write back the DNA characters represents by code into ptext. 
      **/
-    static void decode(unsigned code, char *ptext) {
+    static void decode(t_seed code, char *ptext) {
         unsigned char *t = (unsigned char*)&code;
-        b2t(*t++, ptext, 4);
-        b2t(*t++, ptext+4, 4);
-        b2t(*t++, ptext+8, 4);
-        b2t(*t++, ptext+12, 4);
+        for (size_t k = 0; k < sizeof(t_seed); ++k)
+            b2t(t[k], ptext + 4*k, 4);
     };
 
     /**
@@ -224,6 +330,11 @@ public:
      * Return a pointer the base at pos i. 
      **/
     char* pt(int i) { return forward ? (pdna+i) : (pdna-i); };
+
+    /**
+     * Return an accessor to l bases from pos i, in the same direction. 
+     **/
+    seq_accessor sub(int i, int l) { return seq_accessor(pt(i), forward, l); };
 private:
     char *pdna;
     char *pcur;
@@ -232,4 +343,75 @@ private:
     bool forward;
 };
 
+/**
+ * seq_accessor whose direction is fixed at compile time, DIR is 1 for
+ * forward and -1 for backward. It has the same interface, but none of its
+ * accesses branches on the direction. 
+ **/
+template <int DIR>
+class dir_accessor {
+public:
+    /**
+     * Construct an accessor with *p be the underlying text sequence and l
+     * its length. f must agree with DIR. 
+     **/
+    dir_accessor(char *p, bool f, int l) : pdna(p), pcur(p), len(l), cnt(0) {
+        assert(f == (DIR > 0));
+    };
+    int length() { return len; };
+    bool is_forward() { return DIR > 0; }
+    bool has_more() { return cnt < len; };
+    char next() { ++cnt; char c = *pcur; pcur += DIR; return c; };
+    void reset(int pos) { cnt = pos; pcur = pdna + DIR*pos; };
+    char at(int i) { return pdna[DIR*i]; };
+    char* pt(int i) { return pdna + DIR*i; };
+    dir_accessor sub(int i, int l) { return dir_accessor(pt(i), DIR > 0, l); };
+private:
+    char *pdna;
+    char *pcur;
+    int len;
+    int cnt;
+};
+
+typedef dir_accessor<1> fwd_accessor;
+typedef dir_accessor<-1> rev_accessor;
+
+/**
+ * Accessor into a binary sequence (t_bseq, with its length header), whose
+ * direction is fixed at compile time as dir_accessor. Bases are decoded
+ * from their 2-bit codes when read, so a segment of the mmap'd reads is
+ * aligned in place without being expanded to text first. There is no
+ * pointer access. 
+ **/
+template <int DIR>
+class bin_accessor {
+public:
+    /**
+     * Construct an accessor to l bases of binary sequence pbin from base
+     * pos, which is the last one of the l bases if DIR is -1. 
+     **/
+    bin_accessor(const t_bseq *pbin, int pos, int l) 
+        : pdata(pbin + sizeof(unsigned)), beg(pos), cur(pos), len(l), cnt(0) {};
+    int length() { return len; };
+    bool is_forward() { return DIR > 0; }
+    bool has_more() { return cnt < len; };
+    char next() { ++cnt; char c = base(cur); cur += DIR; return c; };
+    void reset(int pos) { cnt = pos; cur = beg + DIR*pos; };
+    char at(int i) { return base(beg + DIR*i); };
+    bin_accessor sub(int i, int l) { 
+        return bin_accessor(pdata - sizeof(unsigned), beg + DIR*i, l); 
+    };
+private:
+    char base(int k) { return dna_seq::value_at(pdata[k >> 2], k); }
+
+    const t_bseq *pdata;
+    int beg;
+    int cur;
+    int len;
+    int cnt;
+};
+
+typedef bin_accessor<1> fwd_bin_accessor;
+typedef bin_accessor<-1> rev_bin_accessor;
+
 #endif
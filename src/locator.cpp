@@ -16,20 +16,18 @@
 #include	<stdlib.h>
 #include	<stdio.h>
 #include	<string.h>
+#include	<unistd.h>
 #include	"common.h"
 #include	"dna_seq.h"
 #include	"seq_aligner.h"
-
-#define MAX_LOC_LEN 40000
-#define MAX_LOC_DIFF 6000
+#include	"seed_index.h"
+#include	"seed_file.h"
 
 char contig[MAX_SEQ_LEN];
 char sequence[MAX_SEQ_LEN];
-hash_table seedmap(1<<23);
-unsigned seed_pattern;
-seq_aligner<MAX_LOC_LEN, MAX_LOC_DIFF> *paligner;
-
-typedef std::list<int>::iterator list_it;
+seed_index seedmap;
+t_seed seed_pattern;
+t_aligner *paligner;
 
 /* 
  * ===  FUNCTION  ============================================================
@@ -40,46 +38,90 @@ typedef std::list<int>::iterator list_it;
     int
 main ( int argc, char *argv[] )
 { 
-    if (argc <= 2) {
-        fprintf(stderr, "usage: locator contig_file seed < seq_file\n");
+    const char *usage = "usage: locator [-A engine] [-M maxocc] [-w window] [-i index] "
+        "contig_file seed < seq_file\n"
+        "   -A engine   Alignment engine: scalar, bitvec (default), sse, avx2,\n"
+        "               avx512 or simd (the widest one supported by the CPU).\n"
+        "   -M maxocc   Mask the seeds found at more than maxocc positions of\n"
+        "               the contig, i.e., repeats (0, none, by default).\n"
+        "   -w window   Only index and probe the minimizers of every window\n"
+        "               consecutive seeds (0, every seed, by default).\n"
+        "   -i index    Map the index of the contig by the seed, saved by\n"
+        "               seed_builder -c, instead of building it.\n";
+    ENGINE engine = ENGINE_BITVEC;
+    const char *index_file = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "A:M:w:i:")) != -1) {
+        if (opt == 'M') {
+            seedmap.max_occ = atoi(optarg);
+        } else if (opt == 'w') {
+            seedmap.window = atoi(optarg);
+        } else if (opt == 'i') {
+            index_file = optarg;
+        } else if (opt != 'A' 
+                || (engine = (ENGINE)engine_by_name(optarg)) == 0) {
+            fprintf(stderr, "%s", usage);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind < 2) {
+        fprintf(stderr, "%s", usage);
         return EXIT_FAILURE;
     }
 
-    FILE *fp = fopen(argv[1], "r");
+    FILE *fp = fopen(argv[optind], "r");
     fscanf(fp, "%s", contig);
 
-    char str_pat[20];
-    for (int i = 0; i < strlen(argv[2]); ++i)
-        str_pat[i] = (argv[2][i] == '1' ? 'T' : 'A');
+    char str_pat[N_SEQ_WORD];
+    memset(str_pat, 'A', N_SEQ_WORD);
+    for (int i = 0; i < (int)strlen(argv[optind+1]) && i < N_SEQ_WORD; ++i)
+        str_pat[i] = (argv[optind+1][i] == '1' ? 'T' : 'A');
     seed_pattern = dna_seq::encode(str_pat);
 
     // convert N to A
     seq_accessor ac_contig(contig, true, strlen(contig));
-    char *p = contig;
-    for (int i = 0; i < ac_contig.length(); ++i) 
+    for (char *p = contig; *p; ++p) 
         if (*p == 'N') *p = 'A';
 
-    for (int i = 0; i < ac_contig.length(); ++i) {
-        int sd = dna_seq::encode(contig+i);
-        if (sd & seed_pattern) 
-            seedmap[sd & seed_pattern].push_back(i);
+    if (index_file) {
+        const seed_file_header *h = seed_file_map(index_file, SEED_FILE_INDEX);
+        if (h == NULL) return EXIT_FAILURE;
+        if (h->mask != seed_pattern 
+                || h->param[2] != (unsigned long long)ac_contig.length()
+                || h->param[3] != (unsigned long long)seedmap.window) {
+            fprintf(stderr, "%s: not the index of %s by %s\n", index_file, 
+                    argv[optind], argv[optind+1]);
+            return EXIT_FAILURE;
+        }
+        seedmap.map(h);
+    } else {
+        seedmap.set_mask(seed_pattern);
+        seedmap.add_text(contig, ac_contig.length());
+        seedmap.build();
     }
+    if (seedmap.max_occ) 
+        LOG("%lu seeds masked\n", (unsigned long)seedmap.nmasked());
 
-    paligner = new seq_aligner<MAX_LOC_LEN, MAX_LOC_DIFF>(0.15);
+    paligner = new t_aligner(0.15, engine);
     int nseq = 0;
+    t_seed probes[50];
+    std::vector<char> kept;
     while (scanf("%s", sequence) != EOF) {
         int len = strlen(sequence);
         if (len < 500) continue;
         bool found = false;
+        fwd_txt_seeds(txt_bases(sequence), 0).fill(probes, 50);
+        sample_minimizers(probes, 50, seed_pattern, seedmap.window, kept);
         for (int j = 0; j < 50 && !found; ++j) {
-            int seed = dna_seq::encode(sequence+j) & seed_pattern;
-            sm_it sit = seedmap.find(seed);
-            if (sit == seedmap.end()) continue;
+            if (!kept[j]) continue;
+            t_seed seed = probes[j] & seed_pattern;
+            seed_span hits = seedmap.find(seed);
+            if (hits.empty()) continue;
             seq_accessor ac_seg(sequence+j, true, len - j);
-            for (list_it it = sit->second.begin(); it != sit->second.end(); ++it) {
+            for (const int *it = hits.begin(); it != hits.end(); ++it) {
                 seq_accessor ac_ref(contig + *it, true, 
                         ac_contig.length() - *it);
-                if (paligner->align(&ac_seg, &ac_ref) > 0) {
+                if (paligner->align_score(&ac_seg, &ac_ref) > 0) {
                     found = true;
                     printf("%d\t%d\t%d\t%d\t%d\n", nseq, *it, 
                             paligner->final_cost(), len - j,
@@ -15,15 +15,20 @@
 #ifndef REF_SEQ_H
 #define REF_SEQ_H
 
-#include	<list>
+#include	<algorithm>
+#include	<deque>
+#include	<vector>
 
 #include	"dna_seq.h"
 #include	"seq_aligner.h"
+#include	"seed_index.h"
 #include	"common.h"
 
-// the first edit cannot be INSERT
+// an INSERT is supplied to the box before it in the reference, and
+// dropped at bound, the first box forward or past the first one backward
 template <class Iter> 
-void apply_edits(edit *pedit, int nedit, Iter it, bool forward) {
+void apply_edits(const edit *pedit, int nedit, Iter it, Iter bound, 
+        bool forward) {
     for (int i = 0; i < nedit; ++i) {
         if (pedit->op == DELETE) {
             it->ignore();
@@ -31,7 +36,7 @@ void apply_edits(edit *pedit, int nedit, Iter it, bool forward) {
         } else if (pedit->op == MATCH) {
             it->select(pedit->val);
             ++it;
-        } else if (pedit->op == INSERT) {
+        } else if (pedit->op == INSERT && it != bound) {
             if (forward) --it;
             it->supply(pedit->val);
             if (forward) ++it;
@@ -141,6 +146,7 @@ public:
      * reference and the segment. 
      **/
     void select(char c) { selection.add_char(c); ++total; }
+    void select_code(int c) { selection.add_code(c); ++total; }
 
     /**
      * Ignore vote. This happens when the segment want to delete this base
@@ -153,6 +159,7 @@ public:
      * another base right after. 
      **/
     void supply(char c) { suppliment.add_char(c); }
+    void supply_code(int c) { suppliment.add_code(c); }
 
     /**
      * Split suppliment to make it an separated vote_box.
@@ -188,6 +195,36 @@ public:
 };
 
 
+/**
+ * Alignment of a segment to the reference found by ref_seq::align, kept to
+ * be applied later by ref_seq::apply. 
+ **/
+typedef struct {
+    int pos;                    // position of the hit in the reference
+    bool forward;               // direction of the segment
+    bool to_end;                // aligned up to the end of the reference
+    int end;                    // that end when aligned, pre or post
+    int matlen_a;               // length of match in the reference
+    int matlen_b;               // length of match in the segment
+    int cost;                   // cost of the alignment
+    std::vector<edit> edits;    // edits to the reference, none if locked
+} ref_hit;
+
+/**
+ * Votes of an alignment kept by ref_seq::elect in batch, see
+ * ref_seq::batch_votes. 
+ **/
+typedef struct {
+    int pos;                    // position of its first box in the reference
+    int first;                  // its edits in the pool, in forward order
+    int nedit;                  // number of them
+} ballot;
+
+// ballots in the order of the reference, then of elect
+inline bool operator<(const ballot &a, const ballot &b) {
+    return a.pos != b.pos ? a.pos < b.pos : a.first < b.first;
+}
+
 /**
  * Reference sequence. DNA reads (segments) will aligned against it. Once
  * aligned, the segment will express its opinion of the real base at
@@ -204,10 +241,13 @@ public:
     /**
      * Constructor of reference with binary sequence.
      * */
-    ref_seq(const t_bseq *pseq, bool lk = false) : locked(lk) {
-        beg = pre = MAX_SEQ_LEN;
-        end = post = beg + dna_seq::bin2text(pseq, txt_buf+beg, MAX_SEQ_LEN);
-        char *p = txt_buf + beg;
+    ref_seq(const t_bseq *pseq, bool lk = false) 
+        : beg(0), end(0), pre(0), post(0), locked(lk), batched(false), 
+        version(0) {
+        reserve(MAX_READ_LEN, *((const unsigned *)pseq) + MAX_READ_LEN);
+        end = post = beg + dna_seq::bin2text(pseq, buf() + beg, 
+                txt_buf.size() - beg);
+        char *p = buf() + beg;
         for (int i = beg; i < end; ++i)
             consensus.push_back(vote_box(*p++));
     };
@@ -215,17 +255,24 @@ public:
     /**
      * Constructor of reference with text sequence. 
      * */
-    ref_seq(const char *ptxt, int len, bool l, int w = 1) : locked(l) {
-        beg = pre = MAX_SEQ_LEN;
+    ref_seq(const char *ptxt, int len, bool l, int w = 1) 
+        : beg(0), end(0), pre(0), post(0), locked(l), batched(false), 
+        version(0) {
+        reserve(MAX_READ_LEN, len + MAX_READ_LEN);
         end = post = beg + len;
-        strncpy(txt_buf + beg, ptxt, len);
-        char *p = txt_buf + beg;
+        strncpy(buf() + beg, ptxt, len);
+        char *p = buf() + beg;
         for (int i = beg; i < end; ++i)
             consensus.push_back(vote_box(*p++, w));
     };
 
+    /**
+     * Append, or prepend, the len bases of text pseg, which may not be
+     * in the reference. 
+     **/
     void append(char *pseg, int len) {
-        memmove(txt_buf + post, pseg, len);
+        reserve(0, len);
+        memcpy(buf() + post, pseg, len);
         post += len;
         for (int i = 0; i < len; ++i) {
             consensus.push_back(vote_box(*pseg++));
@@ -233,18 +280,47 @@ public:
     }
 
     void prepend(char *pseg, int len) {
+        reserve(len, 0);
         pre = pre - len;
-        memmove(txt_buf + pre, pseg, len);
+        memcpy(buf() + pre, pseg, len);
         pseg = pseg + len - 1;
         for (int i = 0; i < len; ++i) {
             consensus.push_front(vote_box(*pseg--));
         }
     }
+
+    /**
+     * Append len bases of pac from its pos i on, in its order, which may
+     * be a binary sequence. 
+     **/
+    template <class A>
+    void append(A *pac, int i, int len) {
+        reserve(0, len);
+        for (int k = i; k < i + len; ++k) {
+            char c = pac->at(k);
+            txt_buf[post++] = c;
+            consensus.push_back(vote_box(c));
+        }
+    }
+
+    /**
+     * Prepend len bases of pac from its pos i on, each one before the
+     * previous one, i.e., in the order of a backward accessor. 
+     **/
+    template <class A>
+    void prepend(A *pac, int i, int len) {
+        reserve(len, 0);
+        for (int k = i; k < i + len; ++k) {
+            char c = pac->at(k);
+            txt_buf[--pre] = c;
+            consensus.push_front(vote_box(c));
+        }
+    }
     
     /**
      * Checked if there is anything at pos of reference. 
      * */
-    bool contained(int pos) { return pos+beg >= pre && pos+beg < post; }
+    bool contained(int pos) const { return pos+beg >= pre && pos+beg < post; }
 
     /**
      * Return the length of reference. 
@@ -252,27 +328,74 @@ public:
     unsigned length() { return end - beg; }
 
     /*
-     * Try to align pac_seg against the reference starting from pos.
-     * Return true on success. The details of the alignment are available in
-     * paligner. 
+     * Try to align pac_seg against the reference starting from pos, and
+     * apply the alignment at once. Return true on success. The details of
+     * the alignment are available in paligner. See align and apply. 
+     */
+    template <class A>
+    bool try_align(t_aligner *paligner, int pos, A *pac_seg, 
+            t_seed sd_pat = 0) {
+        return align(paligner, pos, pac_seg, sd_pat, &tmp_hit)
+            && apply(paligner, tmp_hit, pac_seg, sd_pat);
+    }
+
+    /*
+     * Align pac_seg against the reference starting from pos, and keep the
+     * alignment in hit, without changing the reference. Return true on
+     * success. A score-only pass decides whether the hit is accepted, the
+     * traceback is only done for accepted hits when the reference is not
+     * locked. Long segments are aligned piecewise between the hits of
+     * spaced seed sd_pat instead, if it is given. A is the type of
+     * accessor, see seq_aligner::align. Threads may align segments at
+     * once, with their own aligners, as long as none applies meanwhile. 
      */
-    bool try_align(t_aligner *paligner, int pos, seq_accessor *pac_seg) {
+    template <class A>
+    bool align(t_aligner *paligner, int pos, A *pac_seg, t_seed sd_pat, 
+            ref_hit *hit) {
         bool forward = pac_seg->is_forward();
-        seq_accessor ac_ref = get_accessor(pos, forward);
-        // don't mistake the order of the two parameters
-        // pac_seg now behave like a reference
-        if (paligner->align(&ac_ref, pac_seg) < 0) return false;
-        if (paligner->matlen_a < OVERLAP_MIN) return false;
-        if (locked) return true;
-        elect(pos, paligner->edits, paligner->nedit, forward);
-        if (paligner->matlen_a == ac_ref.length()) {
-            int add_len = pac_seg->length() - paligner->matlen_b;
-            if (forward) {
-                append(pac_seg->pt(paligner->matlen_b), add_len);
-            } else {
-                prepend(pac_seg->pt(pac_seg->length()-1), add_len);
-            }
+        char *p = buf() + beg + pos;
+        int len = forward ? post-beg-pos : pos+beg-pre+1;
+        assert(contained(pos));
+        bool ok;
+        if (forward) {
+            fwd_accessor ac_ref(p, true, len);
+            ok = search_hit(paligner, &ac_ref, pac_seg, sd_pat);
+        } else {
+            rev_accessor ac_ref(p, false, len);
+            ok = search_hit(paligner, &ac_ref, pac_seg, sd_pat);
         }
+        if (!ok) return false;
+        hit->pos = pos;
+        hit->forward = forward;
+        hit->end = forward ? post : pre;
+        hit->to_end = paligner->matlen_a == len;
+        hit->matlen_a = paligner->matlen_a;
+        hit->matlen_b = paligner->matlen_b;
+        hit->cost = paligner->final_cost();
+        hit->edits.clear();
+        if (!locked)
+            hit->edits.assign(paligner->edits, paligner->edits + paligner->nedit);
+        return true;
+    }
+
+    /*
+     * Apply hit, the alignment of pac_seg found by align: vote for its
+     * edits, and grow by the rest of pac_seg if it reaches an end. If that
+     * end has grown since, pac_seg is aligned again to the reference as it
+     * is now, and hit is replaced by the alignment applied. Return false
+     * if it fails then. Alignments found against the same reference and
+     * applied in the same order give the same reference, whatever order
+     * they were found in. 
+     */
+    template <class A>
+    bool apply(t_aligner *paligner, ref_hit &hit, A *pac_seg, 
+            t_seed sd_pat = 0) {
+        if (locked) return true;
+        if (hit.to_end && hit.end != (hit.forward ? post : pre)
+                && !align(paligner, hit.pos, pac_seg, sd_pat, &hit))
+            return false;
+        apply_hit(hit.edits.empty() ? NULL : &hit.edits[0], hit.edits.size(),
+                hit.pos, hit.to_end, hit.matlen_b, pac_seg);
         return true;
     }
 
@@ -281,95 +404,336 @@ public:
      * */
     seq_accessor get_accessor(int pos, bool forward) {
         assert(contained(pos));
-        return seq_accessor(txt_buf + beg + pos, forward, 
+        return seq_accessor(buf() + beg + pos, forward, 
                 forward ? post-beg-pos : pos+beg-pre+1);
     }
 
     /**
-     * Build (rebuild) seedmap for reference sequence. 
+     * Build (rebuild) seedmap for reference sequence. If it was built at
+     * the previous version of the reference, it is patched with the seeds
+     * changed by evolve instead, unless it samples minimizers, and if it is
+     * up to date, nothing is done.
      **/
-    unsigned get_seedmap(hash_table &seedmap, t_seed sd_pat) {
-        int len = end - beg;
-        int nmax = len - N_SEQ_WORD;
-        int nhead = std::min(nmax, MAX_READ_LEN);
-        seedmap.clear();
-        char *ptext = txt_buf + beg;
-        for (int i = 0; i < nhead; ++i) {
-            unsigned sd = dna_seq::encode(ptext++);
-            // there are a lot of 'AAAAAAAAAAAAAAAA' segments, ignore them
-            if (sd & sd_pat) seedmap[sd & sd_pat].push_back(i);
-        }
-
-        int ntail = std::min(len-MAX_READ_LEN-N_SEQ_WORD, MAX_READ_LEN);
-        ptext = txt_buf + end - N_SEQ_WORD;
-        for (int i = 0; i < ntail; ++i) {
-            unsigned sd = dna_seq::encode(ptext--);
-            if (sd & sd_pat) seedmap[sd & sd_pat].push_back(len-i-N_SEQ_WORD);
-        }
+    unsigned get_seedmap(seed_index &seedmap, t_seed sd_pat) {
+        seedmap.set_mask(sd_pat);
+        return refresh(seedmap, sd_pat);
+    };
 
-        return nhead + (ntail < 0 ? 0 : ntail);
+    /**
+     * Build (rebuild) seedmap of all its patterns for reference sequence,
+     * or patch it, see above.
+     **/
+    unsigned get_seedmap(multi_seed_index &seedmap) {
+        return refresh(seedmap, ~(t_seed)0);
     };
 
     /**
      * Refresh the reference to reflect updated state. The previous
-     * seedmap will be invalidated once evolved. 
+     * seedmap will be invalidated once evolved, but get_seedmap can patch
+     * it: the windows of N_SEQ_WORD bases left unchanged in the seeded
+     * ends are moved, the others are fresh. 
      * */
     void evolve() {
         if (locked) return ;
-        end = pre = beg = MAX_SEQ_LEN;
-        char *p = txt_buf + beg;
+        flush_votes();
+        int old_len = end - beg;
+        int q = pre - beg;      // position of the box before evolve
+        old_txt.assign(buf() + beg, buf() + end);
+        origin.clear();
+        beg = end = post = pre;
+        // one sweep from the old boxes to the new ones, in place of
+        // inserting and erasing boxes in the middle
+        old_boxes.swap(consensus);
+        consensus.clear();
         vote_box vb;
-        std::list<vote_box>::iterator prev;
-        std::list<vote_box>::iterator next;
-        std::list<vote_box>::iterator cur = consensus.begin();
-        while (cur != consensus.end()) {
-            if (cur->has_supply(0.5)) {     // insert
-                cur->split(&vb);
-                next = cur;
-                ++next;
-                if (next == consensus.end()) 
-                    consensus.push_back(vb);
-                else
-                    consensus.insert(next, vb);
-            }
-            if (cur->is_valid(0.5)) {       // match 
-                *p++ = cur->get_vote(); 
-                ++end; 
-                ++cur;
-            } else {                        // delete
-                if (cur != consensus.begin()) { // has prev
-                    prev = cur;
-                    --prev;
-                    prev->suppliment.absorb(cur->selection);
-                } 
-                cur = consensus.erase(cur);
-            }
+        for (size_t i = 0; i < old_boxes.size(); ++i) {
+            vote_box &cur = old_boxes[i];
+            bool split = cur.has_supply(0.5);     // insert
+            if (split) cur.split(&vb);
+            settle(cur, q++, old_len);
+            if (split) settle(vb, -1, old_len);
         }
+        old_boxes.clear();
         post = end;
+
+        // windows unchanged, i.e., N_SEQ_WORD bases of consecutive origins
+        int len = end - beg;
+        int run = 0;
+        moved.assign(old_len, -1);
+        fresh.clear();
+        for (int n = len - 1; n >= 0; --n) {
+            if (origin[n] < 0) run = 0;
+            else if (n+1 < len && origin[n+1] == origin[n] + 1) ++run;
+            else run = 1;
+            int w = window(n, len);
+            if (w == 0) continue;
+            if (run >= N_SEQ_WORD && window(origin[n], old_len) == w)
+                moved[origin[n]] = n;
+            else
+                fresh.push_back(n);
+        }
+        ++version;
+    }
+
+    /**
+     * Keep the votes of elect from now on if batch is true, and cast them
+     * at evolve, sorted by position, in one sweep of the consensus, rather
+     * than one alignment at a time at random places. The reference evolves
+     * the same either way. 
+     **/
+    void batch_votes(bool batch) { 
+        flush_votes();
+        batched = batch; 
     }
 
     // pos should be contained
-    void elect(int pos, edit *pedit, int nedit, bool forward) {
-        if (forward) {
-            std::list<vote_box>::iterator it = consensus.begin();
-            advance(it, pos + beg - pre);
-            apply_edits(pedit, nedit, it, forward);
+    void elect(int pos, const edit *pedit, int nedit, bool forward) {
+        if (batched) {
+            keep_votes(pos, pedit, nedit, forward);
+        } else if (forward) {
+            apply_edits(pedit, nedit, consensus.begin() + (pos + beg - pre), 
+                    consensus.begin(), forward);
         } else {
-            std::list<vote_box>::reverse_iterator it = consensus.rbegin();
-            advance(it, post - beg - pos - 1);
-            apply_edits(pedit, nedit, it, forward);
+            apply_edits(pedit, nedit, 
+                    consensus.rbegin() + (post - beg - pos - 1), 
+                    consensus.rend(), forward);
         }
     }
 private:
+    // elect in batch: keep the edits in forward order, a byte each, from
+    // the box they start at, the INSERTs that no box takes being dropped
+    void keep_votes(int pos, const edit *pedit, int nedit, bool forward) {
+        ballot b = {pos, (int)pool.size(), 0};
+        pool.resize(b.first + nedit);
+        unsigned char *p = &pool[b.first];
+        for (int i = 0; i < nedit; ++i) {
+            const edit &e = pedit[forward ? i : nedit-1-i];
+            *p++ = e.op << 2 | txt_bases(&e.val).code(0);
+            if (!forward && e.op != INSERT) --b.pos;
+        }
+        if (!forward) ++b.pos;
+        if (b.pos + beg == pre)     // no box before the first one
+            while (b.first < (int)pool.size() && pool[b.first] >> 2 == INSERT)
+                ++b.first;
+        b.nedit = pool.size() - b.first;
+        if (b.nedit > 0) ballots.push_back(b);
+    }
+
+    // cast the votes kept by elect in batch, in the order of the reference,
+    // as apply_edits would
+    void flush_votes() {
+        if (ballots.empty()) return;
+        std::sort(ballots.begin(), ballots.end());
+        std::deque<vote_box>::iterator it = consensus.begin();
+        int at = pre - beg;         // position of it
+        for (size_t i = 0; i < ballots.size(); ++i) {
+            it += ballots[i].pos - at;
+            at = ballots[i].pos;
+            std::deque<vote_box>::iterator box = it;
+            const unsigned char *p = &pool[ballots[i].first];
+            for (int k = 0; k < ballots[i].nedit; ++k, ++p) {
+                int op = *p >> 2;
+                if (op == DELETE) 
+                    (box++)->ignore();
+                else if (op == MATCH) 
+                    (box++)->select_code(*p & 0x3);
+                else if (box != consensus.begin()) 
+                    (box-1)->supply_code(*p & 0x3);
+            }
+        }
+        ballots.clear();
+        pool.clear();
+    }
+
+    // evolve: vote box vb, whose position before was o or -1 if it is
+    // split, is the next one if valid, otherwise the last one takes its
+    // votes as suppliment
+    void settle(vote_box &vb, int o, int old_len) {
+        if (vb.is_valid(0.5)) {                 // match
+            char c = vb.get_vote();
+            reserve(0, 1);
+            txt_buf[end++] = c;
+            post = end;
+            origin.push_back(o >= 0 && o < old_len && old_txt[o] == c 
+                    ? o : -1);
+            consensus.push_back(vb);
+        } else if (!consensus.empty()) {        // delete
+            consensus.back().suppliment.absorb(vb.selection);
+        }
+    }
+
+    // align pac_seg to ac_ref, leaving the edits in paligner unless locked
+    template <class R, class A>
+    bool search_hit(t_aligner *paligner, R *ac_ref, A *pac_seg, 
+            t_seed sd_pat) const {
+        // don't mistake the order of the two parameters
+        // pac_seg now behave like a reference
+        if (sd_pat && pac_seg->length() >= CHAIN_MIN_LEN) {
+            if (paligner->align_chained(ac_ref, pac_seg, sd_pat) < 0) 
+                return false;
+            if (paligner->matlen_a < OVERLAP_MIN) return false;
+        } else {
+            if (paligner->align_score(ac_ref, pac_seg) < 0) return false;
+            if (paligner->matlen_a < OVERLAP_MIN) return false;
+            if (locked) return true;
+            if (paligner->align(ac_ref, pac_seg) < 0) return false;
+        }
+        return true;
+    }
+
+    // vote for the nedit edits of an alignment from pos, and grow by the
+    // rest of pac_seg, from matlen_b, if it reaches the end
+    template <class A>
+    void apply_hit(const edit *edits, int nedit, int pos, bool to_end, 
+            int matlen_b, A *pac_seg) {
+        bool forward = pac_seg->is_forward();
+        elect(pos, edits, nedit, forward);
+        if (to_end) {
+            int add_len = pac_seg->length() - matlen_b;
+            if (forward) {
+                append(pac_seg, matlen_b, add_len);
+            } else {
+                prepend(pac_seg, matlen_b, add_len);
+            }
+        }
+    }
+
+    /*
+     * Order of the positions of a seed in the seedmap of a reference of
+     * length len: those of the head ascending, then those of the tail
+     * descending, as add_seeds adds them. 
+     */
+    class seed_order {
+    public:
+        seed_order(int n, int l) : nhead(n), len(l) {};
+        bool operator()(int a, int b) const { return rank(a) < rank(b); }
+    private:
+        int rank(int p) const { return p < nhead ? p : 2*len - p; }
+        int nhead;
+        int len;
+    };
+
+    /*
+     * Seeded window of position p of a reference of length len: 1 if it
+     * is in the head, 2 in the tail, 0 if not seeded. 
+     */
+    static int window(int p, int len) {
+        int nhead = std::min(len - N_SEQ_WORD, MAX_READ_LEN);
+        int ntail = std::min(len - MAX_READ_LEN - N_SEQ_WORD, MAX_READ_LEN);
+        if (p < nhead) return 1;
+        if (p <= len - N_SEQ_WORD && p > len - N_SEQ_WORD - ntail) return 2;
+        return 0;
+    }
+
+    /*
+     * Bring seedmap, seed_index or multi_seed_index, up to the current
+     * version, by patching it if it was built at the previous one. 
+     */
+    template <class I>
+    unsigned refresh(I &seedmap, t_seed sd_pat) {
+        int len = end - beg;
+        unsigned n = std::max(0, std::min(len - N_SEQ_WORD, MAX_READ_LEN))
+            + std::max(0, std::min(len - MAX_READ_LEN - N_SEQ_WORD, 
+                        MAX_READ_LEN));
+        if (seedmap.version == version) return n;
+        if (!seedmap.sampled() && seedmap.version >= 0 
+                && seedmap.version == version - 1) {
+            fkeys.clear();
+            fposs.clear();
+            // fresh is descending, roll through its runs of positions
+            rev_txt_seeds it(txt_bases(buf() + beg), 0);
+            for (size_t f = 0; f < fresh.size(); ++f) {
+                if (f == 0 || fresh[f] != it.pos())
+                    it = rev_txt_seeds(txt_bases(buf() + beg), fresh[f]);
+                t_seed sd = it.next();
+                if (!(sd & sd_pat)) continue;
+                fkeys.push_back(sd & sd_pat);
+                fposs.push_back(fresh[f]);
+            }
+            seedmap.patch(moved, fkeys.empty() ? NULL : &fkeys[0], 
+                    fposs.empty() ? NULL : &fposs[0], fkeys.size(),
+                    seed_order(std::min(len - N_SEQ_WORD, MAX_READ_LEN), len));
+        } else {
+            seedmap.clear();
+            add_seeds(seedmap);
+            seedmap.build();
+        }
+        seedmap.version = version;
+        return n;
+    }
+
+    /*
+     * Add the seeds of both ends of the reference to seedmap, of type
+     * seed_index or multi_seed_index, as runs masked by its patterns. 
+     */
+    template <class I>
+    unsigned add_seeds(I &seedmap) {
+        int len = end - beg;
+        int nmax = len - N_SEQ_WORD;
+        int nhead = std::min(nmax, MAX_READ_LEN);
+        // there are a lot of 'AAAAAAAAAAAAAAAA' segments, add_run ignores them
+        if (nhead > 0) {
+            run.resize(nhead);
+            fwd_txt_seeds(txt_bases(buf() + beg), 0).fill(&run[0], nhead);
+            seedmap.add_run(&run[0], nhead, 0, 1);
+        }
+
+        int ntail = std::min(len-MAX_READ_LEN-N_SEQ_WORD, MAX_READ_LEN);
+        if (ntail > 0) {
+            run.resize(ntail);
+            rev_txt_seeds(txt_bases(buf() + beg), len - N_SEQ_WORD)
+                .fill(&run[0], ntail);
+            seedmap.add_run(&run[0], ntail, len - N_SEQ_WORD, -1);
+        }
+
+        return nhead + (ntail < 0 ? 0 : ntail);
+    };
+
+    // the text of the reference
+    char *buf() { return &txt_buf[0]; }
+
+    // make room for front more bases before pre and back more after post,
+    // and one more after for bin2text. If there is not, the reference is
+    // moved to the middle of a buffer twice as large as it needs, so that
+    // growing by a base takes amortized constant time at either end.
+    void reserve(int front, int back) {
+        if (pre >= front && (int)txt_buf.size() - post > back) return;
+        int len = post - pre;
+        int need = front + len + back + 1;
+        std::vector<char> grown(2 * need);
+        int to = front + need / 2;
+        if (len > 0) memcpy(&grown[to], buf() + pre, len);
+        beg += to - pre;
+        end += to - pre;
+        post += to - pre;
+        pre = to;
+        txt_buf.swap(grown);
+    }
+
     int beg;        // origin of current iteration
     int end;        // end of current iteration
     int pre;        // extension before beg
     int post;       // extension after end
     bool locked;    // prevent from vote and grow
-
-    char txt_buf[3*MAX_SEQ_LEN];
-    unsigned char bin_buf[4+MAX_SEQ_LEN/N_SEQ_BYTE];
-    std::list<vote_box> consensus; 
+    bool batched;   // keep the votes until evolve, see batch_votes
+    int version;    // number of evolve so far
+
+    std::vector<char> old_txt;  // evolve: the reference before
+    std::vector<int> origin;    // evolve: position before, -1 if changed
+    std::deque<vote_box> old_boxes;     // evolve: the consensus before
+    std::vector<ballot> ballots;        // votes kept, see batch_votes
+    std::vector<unsigned char> pool;    // their edits, op << 2 | base
+    std::vector<int> moved;     // new position of unchanged windows or -1
+    std::vector<int> fresh;     // seeded windows changed by the last evolve
+    std::vector<t_seed> fkeys;  // seeds of fresh windows
+    std::vector<int> fposs;     // their positions
+    std::vector<t_seed> run;    // seeds of one end of add_seeds
+    ref_hit tmp_hit;            // alignment of try_align
+
+    // the text from pre to post, with room to grow at both ends
+    std::vector<char> txt_buf;
+    // a box per base from pre to post, at random access for elect
+    std::deque<vote_box> consensus; 
 };
 
 #endif
@@ -0,0 +1,155 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  seed_builder.cpp
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 06:12:40 PM
+ *
+ *    Description:  build seed files once, to be mapped by locator (-i) and
+ *    spaced_seed (-P) instead of seeding their input at every run
+ *
+ *       Revision:  none
+ *
+ * ===========================================================================
+ */
+
+#include	<stdlib.h>
+#include	<stdio.h>
+#include	<string.h>
+#include	<unistd.h>
+#include	<vector>
+#include	"common.h"
+#include	"dna_seq.h"
+#include	"seed_index.h"
+#include	"seed_file.h"
+
+#define handle_error(msg) do { perror(msg); exit(EXIT_FAILURE); } while (0)
+
+char contig[MAX_SEQ_LEN];
+seed_index seedmap;
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  build_index
+ *  Description:  save the seed_index of the contig in cname, masked by
+ *  pattern pat of 1s and 0s, to fp, as locator would build it
+ * ===========================================================================
+ */
+    bool
+build_index ( const char *cname, const char *pat, FILE *fp )
+{
+    FILE *fc = fopen(cname, "r");
+    if (fc == NULL || fscanf(fc, "%s", contig) != 1)
+        handle_error(cname);
+    fclose(fc);
+    int len = strlen(contig);
+    for (char *p = contig; *p; ++p)
+        if (*p == 'N') *p = 'A';
+
+    char str_pat[N_SEQ_WORD];
+    memset(str_pat, 'A', N_SEQ_WORD);
+    for (int i = 0; i < (int)strlen(pat) && i < N_SEQ_WORD; ++i)
+        str_pat[i] = (pat[i] == '1' ? 'T' : 'A');
+    seedmap.set_mask(dna_seq::encode(str_pat));
+    seedmap.add_text(contig, len);
+    seedmap.build();
+    LOG("%lu seeds at %lu positions of %d bases\n",
+            (unsigned long)seedmap.size(), (unsigned long)seedmap.npos(), len);
+    return seedmap.save(fp, len);
+}		/* -----  end of function build_index  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  build_probes
+ *  Description:  save the seeds of the first ntrials windows of both ends
+ *  of every segment of the binary file bname to fp, see SEED_FILE_PROBES
+ * ===========================================================================
+ */
+    bool
+build_probes ( const char *bname, int ntrials, FILE *fp )
+{
+    FILE *fb = fopen(bname, "rb");
+    if (fb == NULL) handle_error(bname);
+    std::vector<unsigned char> bin;
+    unsigned char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fb)) > 0)
+        bin.insert(bin.end(), chunk, chunk + n);
+    fclose(fb);
+
+    std::vector<t_seed> probes;
+    unsigned long long nreads = 0;
+    for (size_t offset = 0; offset + sizeof(unsigned) <= bin.size(); ++nreads) {
+        const t_bseq *seq = &bin[offset];
+        unsigned slen = *((const unsigned*)seq);
+        size_t row = probes.size();
+        probes.resize(row + 2*ntrials, 0);
+        // windows past the other end are left 0
+        int nwin = (int)slen - N_SEQ_WORD + 1;
+        if (nwin > 0) {
+            int w = std::min(nwin, ntrials);
+            fwd_bin_seeds(bin_bases(seq), 0).fill(&probes[row], w);
+            rev_bin_seeds(bin_bases(seq), slen-N_SEQ_WORD)
+                .fill(&probes[row + ntrials], w);
+        }
+        offset += sizeof(unsigned) + (slen + 4 - 1)/4;
+    }
+    LOG("%llu segments, %d trials\n", nreads, ntrials);
+
+    seed_file_header h;
+    memset(&h, 0, sizeof(h));
+    h.kind = SEED_FILE_PROBES;
+    h.param[0] = ntrials;
+    h.param[1] = nreads;
+    h.param[2] = bin.size();
+    const void *secs[1] = {probes.empty() ? NULL : &probes[0]};
+    size_t lens[1] = {probes.size() * sizeof(t_seed)};
+    return seed_file_write(fp, h, secs, lens, 1);
+}		/* -----  end of function build_probes  ----- */
+
+/*
+ * ===  FUNCTION  ============================================================
+ *         Name:  main
+ *  Description:
+ * ===========================================================================
+ */
+    int
+main ( int argc, char *argv[] )
+{
+    const char *usage = "usage: seed_builder -c seed [-w window] "
+        "contig_file out_file\n"
+        "       seed_builder -r ntrials binary_file out_file\n"
+        "   -c seed     Index the contig by the spaced seed, a pattern of 1s\n"
+        "               and 0s, for locator -i.\n"
+        "   -w window   Only index the minimizers of every window consecutive\n"
+        "               seeds of the contig, for locator -w.\n"
+        "   -r ntrials  Probe the seeds of the first ntrials windows of both\n"
+        "               ends of every segment, for spaced_seed -P.\n";
+    const char *pattern = NULL;
+    int ntrials = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:r:w:")) != -1) {
+        if (opt == 'c') {
+            pattern = optarg;
+        } else if (opt == 'w') {
+            seedmap.window = atoi(optarg);
+        } else if (opt == 'r' && (ntrials = atoi(optarg)) > 0) {
+            continue;
+        } else {
+            fprintf(stderr, "%s", usage);
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc - optind < 2 || (pattern == NULL) == (ntrials == 0)) {
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+
+    FILE *fp = fopen(argv[optind+1], "wb");
+    if (fp == NULL) handle_error(argv[optind+1]);
+    bool ok = pattern ? build_index(argv[optind], pattern, fp)
+        : build_probes(argv[optind], ntrials, fp);
+    if (fclose(fp) != 0 || !ok) handle_error(argv[optind+1]);
+
+    return EXIT_SUCCESS;
+}				/* ----------  end of function main  ---------- */
@@ -0,0 +1,145 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  seed_file.h
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 05:46:21 PM
+ *
+ *    Description:  versioned, page-aligned files of seeds, written once by
+ *    seed_builder and mapped read-only by spaced_seed and locator
+ *
+ *       Revision:  none
+ *
+ *
+ * ===========================================================================
+ */
+
+#ifndef SEED_FILE_H
+#define SEED_FILE_H
+
+#include	<stdio.h>
+#include	<string.h>
+#include	<fcntl.h>
+#include	<unistd.h>
+#include	<sys/mman.h>
+#include	<sys/stat.h>
+#include	"common.h"
+
+//! version of the layout of seed files, changed with any of it
+#define SEED_FILE_VERSION 1
+//! the header and every section of a seed file start on such a boundary
+#define SEED_FILE_PAGE 4096
+//! max number of sections of a seed file
+#define SEED_FILE_NSEC 4
+
+/**
+ * Kind of the content of a seed file.
+ **/
+enum SEED_FILE_KIND {
+    SEED_FILE_INDEX = 1,    //!< seed_index of a sequence, see seed_index::save
+    SEED_FILE_PROBES        //!< seeds probed at both ends of every read
+};
+
+/**
+ * Header of a seed file, at its beginning. The sections follow, each at a
+ * multiple of SEED_FILE_PAGE bytes from the beginning, so that they are
+ * used in place once the file is mapped, without being parsed or copied.
+ * Numbers are in the byte order of the writer.
+ *
+ * SEED_FILE_PROBES: param[0] is the number of trials, param[1] the number
+ * of reads and param[2] the size of the binary file of the reads. Section
+ * 0 holds 2*param[0] seeds per read, in the order of the file: those at
+ * positions 0, 1, ..., then those at len-N_SEQ_WORD, len-N_SEQ_WORD-1, ...
+ * Reads too short for them have seeds 0.
+ **/
+typedef struct {
+    char magic[8];                  // "PBSEEDS"
+    unsigned version;               // SEED_FILE_VERSION
+    unsigned kind;                  // SEED_FILE_KIND
+    unsigned seed_bits;             // SEED_BITS of the writer
+    unsigned nsec;                  // number of sections
+    unsigned long long mask;        // pattern of the seeds, 0 if raw
+    unsigned long long param[4];    // depending on kind
+    unsigned long long off[SEED_FILE_NSEC];     // offsets of the sections
+    unsigned long long len[SEED_FILE_NSEC];     // their lengths in bytes
+} seed_file_header;
+
+/**
+ * Write a seed file of header h, whose kind, mask and param are set, and
+ * of the nsec sections secs of lens bytes to fp. Return false on error.
+ **/
+inline bool seed_file_write(FILE *fp, seed_file_header h,
+        const void * const *secs, const size_t *lens, int nsec) {
+    static const char zeros[SEED_FILE_PAGE] = "";
+    memcpy(h.magic, "PBSEEDS", 8);
+    h.version = SEED_FILE_VERSION;
+    h.seed_bits = SEED_BITS;
+    h.nsec = nsec;
+    unsigned long long off = SEED_FILE_PAGE;
+    for (int s = 0; s < nsec; ++s) {
+        h.off[s] = off;
+        h.len[s] = lens[s];
+        off += (lens[s] + SEED_FILE_PAGE - 1) / SEED_FILE_PAGE * SEED_FILE_PAGE;
+    }
+    if (fwrite(&h, sizeof(h), 1, fp) != 1
+            || fwrite(zeros, SEED_FILE_PAGE - sizeof(h), 1, fp) != 1)
+        return false;
+    for (int s = 0; s < nsec; ++s) {
+        size_t pad = (SEED_FILE_PAGE - lens[s] % SEED_FILE_PAGE)
+            % SEED_FILE_PAGE;
+        if ((lens[s] && fwrite(secs[s], lens[s], 1, fp) != 1)
+                || (pad && fwrite(zeros, pad, 1, fp) != 1))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Map the seed file at path read-only, and return its header, the
+ * sections being at their offsets from it. Return NULL, with a message,
+ * if it cannot be mapped or is not a seed file of kind and of the
+ * SEED_FILE_VERSION and SEED_BITS of this build.
+ **/
+inline const seed_file_header* seed_file_map(const char *path, unsigned kind) {
+    int fd = open(path, O_RDONLY);
+    struct stat fst;
+    if (fd == -1 || fstat(fd, &fst) == -1) {
+        perror(path);
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    void *p = MAP_FAILED;
+    if (fst.st_size >= SEED_FILE_PAGE)
+        p = mmap(NULL, fst.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "%s: not a seed file\n", path);
+        return NULL;
+    }
+    const seed_file_header *h = (const seed_file_header*)p;
+    const char *why = NULL;
+    if (memcmp(h->magic, "PBSEEDS", 8) != 0) why = "not a seed file";
+    else if (h->version != SEED_FILE_VERSION) why = "version mismatch";
+    else if (h->kind != kind) why = "wrong kind of seed file";
+    else if (h->seed_bits != SEED_BITS) why = "built with other SEED_BITS";
+    else if (h->nsec > SEED_FILE_NSEC) why = "corrupted";
+    for (unsigned s = 0; !why && s < h->nsec; ++s)
+        if (h->off[s] % SEED_FILE_PAGE
+                || h->off[s] + h->len[s] > (unsigned long long)fst.st_size)
+            why = "truncated";
+    if (why) {
+        fprintf(stderr, "%s: %s\n", path, why);
+        munmap(p, fst.st_size);
+        return NULL;
+    }
+    return h;
+}
+
+/**
+ * Section s of the mapped seed file h.
+ **/
+inline const char* seed_file_section(const seed_file_header *h, int s) {
+    return (const char*)h + h->off[s];
+}
+
+#endif
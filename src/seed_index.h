@@ -0,0 +1,750 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  seed_index.h
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 10:32:05 PM
+ *
+ *    Description:  flat index from seeds to their positions in a sequence
+ *
+ *       Revision:  none
+ *
+ *
+ * ===========================================================================
+ */
+
+#ifndef SEED_INDEX_H
+#define SEED_INDEX_H
+
+#include	<assert.h>
+#include	<algorithm>
+#include	<vector>
+#include	"common.h"
+#include	"dna_seq.h"
+#include	"seed_file.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && SEED_BITS == 32)
+#define SEED_X86
+#include	<immintrin.h>
+#endif
+
+/**
+ * Positions of a seed in seed_index, contiguous in memory.
+ **/
+class seed_span {
+public:
+    seed_span() : first(NULL), last(NULL) {};
+    seed_span(const int *f, const int *l) : first(f), last(l) {};
+    const int* begin() const { return first; };
+    const int* end() const { return last; };
+    size_t size() const { return last - first; };
+    bool empty() const { return first == last; };
+private:
+    const int *first;
+    const int *last;
+};
+
+/**
+ * Hash of seed sd ordering the minimizers, a bijection, so that only equal
+ * seeds tie.
+ **/
+inline t_seed minimizer_hash(t_seed sd) {
+#if SEED_BITS == 64
+    sd = (sd ^ (sd >> 30)) * 0xBF58476D1CE4E5B9ull;
+    sd = (sd ^ (sd >> 27)) * 0x94D049BB133111EBull;
+    return sd ^ (sd >> 31);
+#else
+    sd = (sd ^ (sd >> 16)) * 0x85EBCA6Bu;
+    sd = (sd ^ (sd >> 13)) * 0xC2B2AE35u;
+    return sd ^ (sd >> 16);
+#endif
+}
+
+/**
+ * (w, N_SEQ_WORD) minimizers of the seeds sds of n consecutive windows,
+ * masked by m: of every w consecutive seeds, keep those of the least
+ * minimizer_hash, all of them on a tie, so that the same ones are kept
+ * whichever direction the windows are listed in. Two sequences sharing
+ * w+N_SEQ_WORD-1 bases keep a seed at the same place of both. If n < w
+ * the n seeds are one window. keep[i] is set for the seeds kept, every
+ * one if w <= 1, and never for those masked to 0.
+ **/
+inline void sample_minimizers(const t_seed *sds, int n, t_seed m, int w,
+        std::vector<char> &keep) {
+    keep.assign(n, 0);
+    if (w <= 1 || n <= 0) {
+        for (int i = 0; i < n; ++i) keep[i] = (sds[i] & m) != 0;
+        return;
+    }
+    w = std::min(w, n);
+    for (int i = 0; i + w <= n; ++i) {
+        bool any = false;
+        t_seed lo = 0;
+        for (int j = i; j < i + w; ++j) {
+            if (!(sds[j] & m)) continue;
+            t_seed h = minimizer_hash(sds[j] & m);
+            if (!any || h < lo) lo = h;
+            any = true;
+        }
+        for (int j = i; any && j < i + w; ++j)
+            if ((sds[j] & m) && minimizer_hash(sds[j] & m) == lo) keep[j] = 1;
+    }
+}
+
+/**
+ * Flat index of the seeds of a sequence, in compressed sparse row form.
+ * (seed, position) pairs are added in any order, then build distributes
+ * them by a hash of the seed into about one bucket per position with a
+ * stable counting sort, then sorts every bucket by seed. So the positions
+ * of a seed are contiguous and keep the order they were added in, and a
+ * lookup reads the offsets of one bucket and searches the few seeds in it.
+ * Memory is about 12 bytes per position, and nothing is allocated per seed
+ * or per position.
+ *
+ * If the seeds are masked by a spaced seed pattern of at most
+ * MAX_DIRECT_BITS bits, set_mask makes the index direct-address: the masked
+ * bits of a seed are compacted (BMI2 PEXT, or byte tables where the CPU
+ * lacks it) into a dense key, which indexes a table of 2^w slots for a
+ * pattern of w bits, whatever the positions. A slot holds the range of
+ * one seed, so a lookup is one load. build only touches the slots of the
+ * seeds added, and of those of the previous build to clear them.
+ *
+ * After the sequence is edited, patch moves the positions still valid and
+ * adds the new ones, instead of indexing the whole sequence again.
+ *
+ * Seeds of more than max_occ positions (repeats, low-complexity windows)
+ * are masked: find returns no position for them, so the work of a lookup
+ * is bounded. They are still indexed, so that max_occ can change, and a
+ * patched index masks the same seeds as one built from scratch.
+ *
+ * A built index can be saved to a seed file, whose sections are its arrays
+ * as they are in memory. An index mapping such a file finds seeds in place,
+ * with nothing to parse or build, but cannot be changed.
+ *
+ * With a window above 1, add_run samples the (window, N_SEQ_WORD)
+ * minimizers of a sequence instead of adding all its seeds, which cuts the
+ * positions by about window/2. The probes of a read must be sampled alike,
+ * see sample_minimizers. patch cannot tell which moved seeds are still
+ * minimizers, so a sampled index is built again instead.
+ **/
+class seed_index {
+public:
+    //! widest compacted key of the direct-address table, 128 MB of slots
+    static const int MAX_DIRECT_BITS = 24;
+    bool pext;          //! compact keys with PEXT, set if the CPU has BMI2
+    //! version of the sequence indexed, -1 if none, kept by its owner
+    int version;
+    //! seeds of more positions are masked, 0 if none
+    unsigned max_occ;
+    //! add_run only adds the (window, N_SEQ_WORD) minimizers, if above 1
+    int window;
+
+    seed_index() : pext(false), version(-1), max_occ(0), window(0), nbits(0), 
+        mask(0),
+        direct(false), built(false), mapped(false) { bind(); };
+
+    /**
+     * Seeds added are masked by mask, the index becomes direct-address if
+     * mask has at most max_bits bits, hashed otherwise or if mask is 0. The
+     * index is emptied if the mask changes.
+     **/
+    void set_mask(t_seed m, int max_bits = MAX_DIRECT_BITS) {
+        int w = __builtin_popcountll(m);
+        bool d = m != 0 && w <= std::min(max_bits, (int)MAX_DIRECT_BITS);
+        if (m == mask && d == direct) return;
+        clear();
+        set_tables(m, d);
+        slots.clear();
+        used.clear();
+        if (direct) slots.resize((size_t)1 << w);
+    }
+
+    /**
+     * Check if the index is direct-address.
+     **/
+    bool is_direct() const { return direct; }
+
+    /**
+     * Remove all the seeds. A mapped file is left alone, the index is no
+     * longer using it.
+     **/
+    void clear() {
+        keys.clear();
+        poss.clear();
+        occs.clear();
+        version = -1;
+        built = false;
+        if (mapped) {
+            mapped = false;
+            mask = 0;
+            direct = false;
+        }
+        bind();
+    }
+
+    /**
+     * Add seed sd at position pos. build must be called before find.
+     **/
+    void add(t_seed sd, int pos) {
+        assert(!mapped);
+        keys.push_back(sd);
+        poss.push_back(pos);
+        built = false;
+    }
+
+    /**
+     * Add the raw seeds sds of n consecutive windows, at positions pos,
+     * pos+step, ..., masked by the mask of the index (every bit if 0),
+     * unless they are masked to 0. Only their minimizers are added if
+     * window is above 1, see sample_minimizers.
+     **/
+    void add_run(const t_seed *sds, int n, int pos, int step) {
+        t_seed m = mask ? mask : ~(t_seed)0;
+        sample_minimizers(sds, n, m, window, tkeep);
+        for (int i = 0; i < n; ++i, pos += step)
+            if (tkeep[i]) add(sds[i] & m, pos);
+    }
+
+    /**
+     * Add the seeds of the windows at positions 0 to n-1 of text, see
+     * add_run.
+     **/
+    void add_text(const char *text, int n) {
+        if (n <= 0) return;
+        std::vector<t_seed> sds(n);
+        fwd_txt_seeds(txt_bases(text), 0).fill(&sds[0], n);
+        add_run(&sds[0], n, 0, 1);
+    }
+
+    /**
+     * Check if only the minimizers of the seeds are added.
+     **/
+    bool sampled() const { return window > 1; }
+
+    /**
+     * Sort the seeds added so far, making them available to find.
+     **/
+    void build() {
+        assert(!mapped);
+        occs.clear();
+        built = true;
+        if (direct)
+            build_direct();
+        else
+            build_hashed();
+        bind();
+    }
+
+    /**
+     * Write the built index to fp as a seed file, with user value p0 in its
+     * header (param[2]). Return false on error.
+     **/
+    bool save(FILE *fp, unsigned long long p0 = 0) const {
+        assert(built);
+        seed_file_header h;
+        memset(&h, 0, sizeof(h));
+        h.kind = SEED_FILE_INDEX;
+        h.mask = mask;
+        h.param[0] = direct;
+        h.param[1] = nbits;
+        h.param[2] = p0;
+        h.param[3] = window;
+        const void *secs[4] = {pkeys, pposs, poccs,
+            direct ? (const void*)pslots : (const void*)phead};
+        size_t lens[4] = {nposs * sizeof(t_seed), nposs * sizeof(int),
+            noccs * sizeof(unsigned),
+            ntab * (direct ? sizeof(t_slot) : sizeof(unsigned))};
+        return seed_file_write(fp, h, secs, lens, 4);
+    }
+
+    /**
+     * Use the index of seed file h, mapped by seed_file_map, until the
+     * next clear or set_mask. Return false if it is not a seed_index.
+     **/
+    bool map(const seed_file_header *h) {
+        if (h->kind != SEED_FILE_INDEX || h->nsec != 4) return false;
+        clear();
+        set_tables(h->mask, h->param[0] != 0);
+        nbits = h->param[1];
+        window = h->param[3];
+        mapped = true;
+        built = true;
+        pkeys = (const t_seed*)seed_file_section(h, 0);
+        pposs = (const int*)seed_file_section(h, 1);
+        poccs = (const unsigned*)seed_file_section(h, 2);
+        nposs = h->len[1] / sizeof(int);
+        noccs = h->len[2] / sizeof(unsigned);
+        if (direct) {
+            pslots = (const t_slot*)seed_file_section(h, 3);
+            ntab = h->len[3] / sizeof(t_slot);
+        } else {
+            phead = (const unsigned*)seed_file_section(h, 3);
+            ntab = h->len[3] / sizeof(unsigned);
+        }
+        return true;
+    }
+
+    /**
+     * Check if the index is mapped from a seed file.
+     **/
+    bool is_mapped() const { return mapped; }
+
+    /**
+     * Update the index built from a sequence after it is edited. The
+     * position p becomes moved[p], or is removed if that is negative, and
+     * the nfresh seeds fkeys are added at positions fposs. The positions of
+     * a seed which gets new ones are put in the order of less, all those
+     * of the others must keep theirs when moved.
+     **/
+    template <class Less>
+    void patch(const std::vector<int> &moved, const t_seed *fkeys,
+            const int *fposs, int nfresh, Less less) {
+        assert(!mapped && !sampled());
+        size_t n = 0;
+        for (size_t i = 0; i < poss.size(); ++i) {
+            int p = poss[i];
+            if (p < 0 || p >= (int)moved.size() || moved[p] < 0) continue;
+            keys[n] = keys[i];
+            poss[n++] = moved[p];
+        }
+        keys.resize(n);
+        poss.resize(n);
+        for (int f = 0; f < nfresh; ++f) add(fkeys[f], fposs[f]);
+        build();
+
+        tkeys.assign(fkeys, fkeys + nfresh);
+        std::sort(tkeys.begin(), tkeys.end());
+        tkeys.erase(std::unique(tkeys.begin(), tkeys.end()), tkeys.end());
+        for (size_t k = 0; k < tkeys.size(); ++k) {
+            seed_span sp = span(tkeys[k]);
+            int *p = &poss[0] + (sp.begin() - &poss[0]);
+            std::sort(p, p + sp.size(), less);
+        }
+    }
+
+    /**
+     * Positions of seed sd, in the order they were added, empty if none or
+     * if it is masked.
+     **/
+    seed_span find(t_seed sd) const {
+        seed_span sp = span(sd);
+        return max_occ && sp.size() > max_occ ? seed_span() : sp;
+    }
+
+    /**
+     * Number of distinct seeds.
+     **/
+    size_t size() const { return noccs; }
+
+    /**
+     * Number of seeds masked for having more than max_occ positions.
+     **/
+    size_t nmasked() const {
+        if (!max_occ) return 0;
+        size_t n = 0;
+        for (size_t g = 0; g < noccs; ++g) n += poccs[g] > max_occ;
+        return n;
+    }
+
+    /**
+     * Number of positions.
+     **/
+    size_t npos() const { return nposs; }
+
+    /**
+     * Masked bits of sd packed into the low bits, valid once set_mask has
+     * made the index direct-address.
+     **/
+    t_seed compact(t_seed sd) const {
+#ifdef SEED_X86
+        if (pext) return pext_seed(sd, mask);
+#endif
+        t_seed c = ctab[0][sd & 0xFF] | ctab[1][(sd >> 8) & 0xFF]
+            | ctab[2][(sd >> 16) & 0xFF] | ctab[3][(sd >> 24) & 0xFF];
+#if SEED_BITS == 64
+        c |= ctab[4][(sd >> 32) & 0xFF] | ctab[5][(sd >> 40) & 0xFF]
+            | ctab[6][(sd >> 48) & 0xFF] | ctab[7][sd >> 56];
+#endif
+        return c;
+    }
+private:
+#ifdef SEED_X86
+    __attribute__((target("bmi2")))
+    static t_seed pext_seed(t_seed sd, t_seed m) { 
+#if SEED_BITS == 64
+        return _pext_u64(sd, m); 
+#else
+        return _pext_u32(sd, m); 
+#endif
+    }
+#endif
+
+    static const unsigned SMALL_BUCKET = 16;
+
+    // positions of seed sd, masked or not
+    seed_span span(t_seed sd) const {
+        assert(built);
+        if (nposs == 0) return seed_span();
+        if (direct) {
+            if (sd & ~mask) return seed_span();
+            const t_slot &s = pslots[compact(sd)];
+            return seed_span(pposs + s.lo, pposs + s.hi);
+        }
+        size_t b = bucket(sd);
+        std::pair<const t_seed*, const t_seed*> r =
+            std::equal_range(pkeys + phead[b], pkeys + phead[b+1], sd);
+        return seed_span(pposs + (r.first - pkeys), pposs + (r.second - pkeys));
+    }
+
+    // point at the arrays built
+    void bind() {
+        pkeys = keys.empty() ? NULL : &keys[0];
+        pposs = poss.empty() ? NULL : &poss[0];
+        poccs = occs.empty() ? NULL : &occs[0];
+        pslots = slots.empty() ? NULL : &slots[0];
+        phead = head.empty() ? NULL : &head[0];
+        nposs = poss.size();
+        noccs = occs.size();
+        ntab = direct ? slots.size() : head.size();
+    }
+
+    // range of the positions of a seed, empty if lo == hi
+    typedef struct {
+        unsigned lo;
+        unsigned hi;
+    } t_slot;
+
+    typedef std::pair<t_seed, int> t_entry;
+    static bool key_less(const t_entry &a, const t_entry &b) {
+        return a.first < b.first;
+    }
+
+    /*
+     * Set mask m and the tables compacting it, for a direct-address index
+     * if d.
+     */
+    void set_tables(t_seed m, bool d) {
+        mask = m;
+        direct = d;
+        if (!direct) return;
+        // bits of every byte of a seed, compacted and placed in the key
+        int low = 0;
+        for (size_t k = 0; k < sizeof(t_seed); ++k) {
+            unsigned bm = (m >> (8*k)) & 0xFF;
+            for (unsigned v = 0; v < 256; ++v) {
+                t_seed c = 0;
+                int o = 0;
+                for (int t = 0; t < 8; ++t) {
+                    if (!(bm >> t & 1)) continue;
+                    c |= (t_seed)(v >> t & 1) << o++;
+                }
+                ctab[k][v] = c << low;
+            }
+            low += __builtin_popcount(bm);
+        }
+#ifdef SEED_X86
+        pext = __builtin_cpu_supports("bmi2");
+#endif
+    }
+
+    /*
+     * Hashed build: place the seeds stably into buckets by a counting sort,
+     * then sort every bucket by seed.
+     */
+    void build_hashed() {
+        size_t n = keys.size();
+        for (nbits = 1; nbits < 30 && ((size_t)1 << nbits) < n; ++nbits) ;
+        size_t nbucket = (size_t)1 << nbits;
+        head.assign(nbucket + 1, 0);
+        if (n == 0) return;
+
+        // count, then place stably into the buckets
+        for (size_t i = 0; i < n; ++i) ++head[bucket(keys[i]) + 1];
+        for (size_t b = 0; b < nbucket; ++b) head[b+1] += head[b];
+        tnext.assign(head.begin(), head.end() - 1);
+        tkeys.resize(n);
+        tposs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            unsigned d = tnext[bucket(keys[i])]++;
+            tkeys[d] = keys[i];
+            tposs[d] = poss[i];
+        }
+        keys.swap(tkeys);
+        poss.swap(tposs);
+
+        // sort every bucket by seed, keeping the order of equal ones
+        for (size_t b = 0; b < nbucket; ++b) {
+            unsigned lo = head[b], hi = head[b+1];
+            if (hi - lo > SMALL_BUCKET) {
+                sort_bucket(lo, hi);
+            } else {
+                for (unsigned i = lo + 1; i < hi; ++i) {
+                    t_seed k = keys[i];
+                    int p = poss[i];
+                    unsigned j = i;
+                    for (; j > lo && keys[j-1] > k; --j) {
+                        keys[j] = keys[j-1];
+                        poss[j] = poss[j-1];
+                    }
+                    keys[j] = k;
+                    poss[j] = p;
+                }
+            }
+            for (unsigned i = lo; i < hi; ++i) {
+                if (i == lo || keys[i] != keys[i-1]) occs.push_back(0);
+                ++occs.back();
+            }
+        }
+    }
+
+    /*
+     * Direct-address build: count the positions of every seed in its slot,
+     * give the seeds their ranges in the order they first appear, then
+     * place the positions stably. Slots of the previous build are cleared
+     * first, so a build costs the number of positions, not of slots.
+     */
+    void build_direct() {
+        for (size_t u = 0; u < used.size(); ++u) {
+            slots[used[u]].lo = slots[used[u]].hi = 0;
+        }
+        used.clear();
+        size_t n = keys.size();
+        tnext.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            unsigned c = tnext[i] = compact(keys[i]);
+            if (slots[c].hi++ == 0) used.push_back(c);
+        }
+        unsigned off = 0;
+        for (size_t u = 0; u < used.size(); ++u) {
+            t_slot &s = slots[used[u]];
+            unsigned cnt = s.hi;
+            s.lo = s.hi = off;
+            off += cnt;
+            occs.push_back(cnt);
+        }
+        tkeys.resize(n);
+        tposs.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            unsigned d = slots[tnext[i]].hi++;
+            tkeys[d] = keys[i];
+            tposs[d] = poss[i];
+        }
+        keys.swap(tkeys);
+        poss.swap(tposs);
+    }
+
+    // stable sort of the seeds of a large bucket [lo, hi)
+    void sort_bucket(unsigned lo, unsigned hi) {
+        tents.clear();
+        for (unsigned i = lo; i < hi; ++i)
+            tents.push_back(t_entry(keys[i], poss[i]));
+        std::stable_sort(tents.begin(), tents.end(), key_less);
+        for (unsigned i = lo; i < hi; ++i) {
+            keys[i] = tents[i-lo].first;
+            poss[i] = tents[i-lo].second;
+        }
+    }
+
+    // multiplicative hash of sd into nbits bits
+    size_t bucket(t_seed sd) const {
+#if SEED_BITS == 64
+        return (size_t)((sd * 0x9E3779B97F4A7C15ull) >> (64 - nbits));
+#else
+        return (unsigned)(sd * 2654435761u) >> (32 - nbits);
+#endif
+    }
+
+    std::vector<t_seed> keys;       // seeds, grouped by seed once built
+    std::vector<int> poss;          // positions, in the order of keys
+    std::vector<t_seed> tkeys;      // scratch of build
+    std::vector<int> tposs;         // scratch of build
+    std::vector<unsigned> head;     // hashed: offset of every bucket
+    std::vector<unsigned> tnext;    // next free slot of every bucket
+    std::vector<t_entry> tents;     // scratch of a large bucket
+    std::vector<char> tkeep;        // minimizers of a run of add_run
+    std::vector<t_slot> slots;      // direct: range of every seed
+    std::vector<unsigned> used;     // direct: slots of the seeds indexed
+    std::vector<unsigned> occs;     // number of positions of every seed
+    int nbits;                      // log2 of the number of buckets
+    t_seed mask;                    // mask of the seeds, 0 if unknown
+    bool direct;                    // buckets addressed by compacted seeds
+    t_seed ctab[sizeof(t_seed)][256]; // compacted bits of every byte value
+    bool built;                     // keys sorted since the last add
+    bool mapped;                    // arrays in a mapped seed file
+    // arrays used by find, those above or those of a mapped seed file
+    const t_seed *pkeys;
+    const int *pposs;
+    const unsigned *poccs;
+    const t_slot *pslots;
+    const unsigned *phead;
+    size_t nposs;
+    size_t noccs;
+    size_t ntab;                    // number of slots or of bucket offsets
+};
+
+/**
+ * Seed indices of several spaced seed patterns of a sequence, built in one
+ * scan of it. Every pattern has its own seed_index, direct-address if all
+ * the tables fit in the one of a single pattern of MAX_DIRECT_BITS bits,
+ * hashed otherwise. Seeds added are raw, every pattern masks them itself
+ * and ignores those it masks to 0.
+ **/
+class multi_seed_index {
+public:
+    //! version of the sequence indexed, -1 if none, kept by its owner
+    int version;
+
+    multi_seed_index() : version(-1), max_occ(0), window(0) {};
+
+    /**
+     * Index the patterns pats from the next build. The index is emptied if
+     * they change.
+     **/
+    void set_patterns(const std::vector<t_seed> &pats) {
+        if (pats == patterns) return;
+        patterns = pats;
+        parts.resize(pats.size());
+        const size_t limit = (size_t)1 << seed_index::MAX_DIRECT_BITS;
+        size_t total = 0;
+        for (size_t k = 0; k < pats.size() && total <= limit; ++k) {
+            int w = __builtin_popcountll(pats[k]);
+            total += w > seed_index::MAX_DIRECT_BITS ? limit+1 : (size_t)1 << w;
+        }
+        bool direct = total <= limit;
+        for (size_t k = 0; k < pats.size(); ++k) {
+            parts[k].set_mask(pats[k], direct ? SEED_BITS : 0);
+            parts[k].max_occ = max_occ;
+            parts[k].window = window;
+        }
+        clear();
+    }
+
+    /**
+     * Mask the seeds of more than n positions in every pattern, 0 for none.
+     **/
+    void set_max_occ(unsigned n) {
+        max_occ = n;
+        for (size_t k = 0; k < parts.size(); ++k) parts[k].max_occ = n;
+    }
+
+    /**
+     * Only add the (w, N_SEQ_WORD) minimizers of every pattern from the
+     * next build, see seed_index::window. The index is emptied if w
+     * changes.
+     **/
+    void set_window(int w) {
+        if (w == window) return;
+        window = w;
+        for (size_t k = 0; k < parts.size(); ++k) parts[k].window = w;
+        clear();
+    }
+
+    /**
+     * Check if only the minimizers of the seeds are added.
+     **/
+    bool sampled() const { return window > 1; }
+
+    /**
+     * Number of patterns.
+     **/
+    int npattern() const { return patterns.size(); }
+
+    /**
+     * The k-th pattern.
+     **/
+    t_seed pattern(int k) const { return patterns[k]; }
+
+    /**
+     * Remove all the seeds.
+     **/
+    void clear() {
+        for (size_t k = 0; k < parts.size(); ++k) parts[k].clear();
+        version = -1;
+    }
+
+    /**
+     * Add raw seed sd at position pos to every pattern.
+     **/
+    void add(t_seed sd, int pos) {
+        for (size_t k = 0; k < parts.size(); ++k)
+            if (sd & patterns[k]) parts[k].add(sd & patterns[k], pos);
+    }
+
+    /**
+     * Add raw seeds of consecutive windows to every pattern, see
+     * seed_index::add_run.
+     **/
+    void add_run(const t_seed *sds, int n, int pos, int step) {
+        for (size_t k = 0; k < parts.size(); ++k)
+            parts[k].add_run(sds, n, pos, step);
+    }
+
+    /**
+     * Sort the seeds added so far, making them available to find.
+     **/
+    void build() {
+        for (size_t k = 0; k < parts.size(); ++k) parts[k].build();
+    }
+
+    /**
+     * Patch every pattern, see seed_index::patch, with raw seeds fkeys.
+     **/
+    template <class Less>
+    void patch(const std::vector<int> &moved, const t_seed *fkeys,
+            const int *fposs, int nfresh, Less less) {
+        for (size_t k = 0; k < parts.size(); ++k) {
+            tkeys.clear();
+            tposs.clear();
+            for (int f = 0; f < nfresh; ++f) {
+                if (!(fkeys[f] & patterns[k])) continue;
+                tkeys.push_back(fkeys[f] & patterns[k]);
+                tposs.push_back(fposs[f]);
+            }
+            parts[k].patch(moved, tkeys.empty() ? NULL : &tkeys[0],
+                    tposs.empty() ? NULL : &tposs[0], tkeys.size(), less);
+        }
+    }
+
+    /**
+     * Positions of raw seed sd under the k-th pattern.
+     **/
+    seed_span find(int k, t_seed sd) const {
+        return parts[k].find(sd & patterns[k]);
+    }
+
+    /**
+     * Number of distinct seeds of all the patterns.
+     **/
+    size_t size() const {
+        size_t n = 0;
+        for (size_t k = 0; k < parts.size(); ++k) n += parts[k].size();
+        return n;
+    }
+
+    /**
+     * Number of positions of all the patterns.
+     **/
+    size_t npos() const {
+        size_t n = 0;
+        for (size_t k = 0; k < parts.size(); ++k) n += parts[k].npos();
+        return n;
+    }
+
+    /**
+     * Number of seeds masked in all the patterns.
+     **/
+    size_t nmasked() const {
+        size_t n = 0;
+        for (size_t k = 0; k < parts.size(); ++k) n += parts[k].nmasked();
+        return n;
+    }
+private:
+    std::vector<t_seed> patterns;
+    std::vector<seed_index> parts;  // index of every pattern
+    std::vector<t_seed> tkeys;      // fresh seeds of a pattern
+    std::vector<int> tposs;         // their positions
+    unsigned max_occ;               // see seed_index::max_occ
+    int window;                     // see seed_index::window
+};
+
+#endif
@@ -16,12 +16,17 @@
 #ifndef SEQ_ALIGNER_H
 #define SEQ_ALIGNER_H
 
+#include	<stdlib.h>
 #include	<string.h>
 #include	<math.h>
 #include	<limits.h>
 #include	<vector>
+#include	<utility>
 #include	<algorithm>
 #include	"dna_seq.h"
+#include	"bit_engine.h"
+#include	"simd_engine.h"
+#include	"batch_engine.h"
 #include	"common.h"
 
 //#define DEBUG_ALIGNER
@@ -43,6 +48,98 @@ typedef struct {
     char val;       //!< Value to insert, or value matched. 
 } edit;
 
+/**
+ * Seed hit between seg_a[i:i+N_SEQ_WORD] and seg_b[j:j+N_SEQ_WORD], and the
+ * best co-linear chain of hits from the origin ending with it. 
+ **/
+typedef struct {
+    int i;          //!< Position in seg_a.
+    int j;          //!< Position in seg_b.
+    int score;      //!< Bases covered by the chain, -1 if unreachable.
+    int prev;       //!< Previous hit of the chain, -1 for the origin.
+} anchor;
+
+/**
+ * Result of one pair of seq_aligner::align_batch. 
+ **/
+typedef struct {
+    int ret;        //!< Return value of align_score, -1 if fail.
+    int matlen_a;   //!< Length of match in seg_a.
+    int matlen_b;   //!< Length of match in seg_b.
+    int cost;       //!< Cost of the alignment.
+} batch_result;
+
+/**
+ * Return the name of engine e. 
+ **/
+inline const char* engine_name(ENGINE e) {
+    static const char *names[] = {"", "scalar", "bitvec", "sse", "avx2", "avx512"};
+    return names[e];
+}
+
+/**
+ * Return the engine named by str, "simd" stands for the widest SIMD engine
+ * supported by the CPU. Return 0 if the name is unknown. 
+ **/
+inline int engine_by_name(const char *str) {
+    if (strcmp(str, "simd") == 0) return simd_engine::widest();
+    for (int e = ENGINE_SCALAR; e <= ENGINE_AVX512; ++e) 
+        if (strcmp(str, engine_name((ENGINE)e)) == 0) return e;
+    return 0;
+}
+
+/**
+ * Workspace of seq_aligner, i.e., buffers of the engines and the edits.
+ * They are sized at run time and only grow, so an aligner stops allocating
+ * once it has seen its longest segments, whatever their length is. Free
+ * workspaces are pooled per thread: an aligner takes one from the pool of
+ * the thread constructing it and gives it back when destroyed, so aligners
+ * created over and over by a thread reuse the same memory, and threads never
+ * share a workspace. 
+ **/
+struct aligner_workspace {
+    bit_engine bv;                      //! bit-parallel engine
+    simd_engine sv;                     //! anti-diagonal SIMD engine
+    batch_engine bt;                    //! inter-sequence SIMD engine
+    std::vector<batch_pair> pairs;      //! batch: pairs to align
+    std::vector<int> rows;              //! scalar: two rolling rows of costs
+    std::vector<int> last_col;          //! scalar: cost at (i, len_b)
+    std::vector<unsigned char> trace;   //! scalar: parents, 2 bits per cell
+    std::vector<edit> edits;            //! edits of the last alignment
+    std::vector<std::pair<t_seed, int> > kmers;     //! chain: seeds of seg_a
+    std::vector<anchor> anchors;        //! chain: seed hits
+    std::vector<int> gap;               //! chain: costs of a gap
+    std::vector<edit> chain;            //! chain: edits of all the pieces
+
+    /**
+     * Take a workspace from the pool of the calling thread.
+     **/
+    static aligner_workspace* acquire() {
+        std::vector<aligner_workspace*> &fl = pool().ws;
+        if (fl.empty()) return new aligner_workspace();
+        aligner_workspace *ws = fl.back();
+        fl.pop_back();
+        return ws;
+    }
+
+    /**
+     * Give a workspace back to the pool of the calling thread. 
+     **/
+    static void release(aligner_workspace *ws) { pool().ws.push_back(ws); }
+private:
+    // free workspaces of a thread, deleted when the thread exits
+    struct free_list {
+        std::vector<aligner_workspace*> ws;
+        ~free_list() {
+            for (size_t i = 0; i < ws.size(); ++i) delete ws[i];
+        }
+    };
+    static free_list& pool() {
+        static thread_local free_list fl;
+        return fl;
+    }
+};
+
 /**
  * Sequence aligner class. Perform the dynamic programming procedure to align
  * one sequence against other. If the align function is called to align two
@@ -50,35 +147,51 @@ typedef struct {
  * information will be invalidated when align is called next time. The
  * aligner expect the two sequence to be similar to each other, the
  * maximum difference (ratio) allowed is specified by the one parameter in the
- * constructor. This class is parameterized with two integer template
- * variables which are roughly the maximum length allowed and the maximum
- * difference allowed between two sequences. 
+ * constructor. There is no limit on the length of the sequences, the
+ * workspace grows on demand (see aligner_workspace). The band is filled by the
+ * bit-parallel engine by default, the scalar engine is kept as reference,
+ * and the anti-diagonal SIMD engines can be selected at runtime. 
  **/
-template <int MAXN, int MAXM>
 class seq_aligner {
-    // DP state
-    typedef struct {
-        int cost;        
-        int parent;      
-    } state;
 public:
     /**
      * Default constructor. Use MAXR as the ratio of max difference. 
      * */
-    seq_aligner() : R(MAXR) {};
+    seq_aligner() : R(MAXR), engine(ENGINE_BITVEC), xdrop(0), edits(NULL), 
+        ws(aligner_workspace::acquire()) {};
     /**
      * Use r as the ratio of max difference. 
      * */
-    seq_aligner(double r) : R(r) {};
+    seq_aligner(double r) : R(r), engine(ENGINE_BITVEC), xdrop(0), edits(NULL), 
+        ws(aligner_workspace::acquire()) {};
+    /**
+     * Use r as the ratio of max difference and e as the engine. If e is not
+     * supported by the CPU, the widest one supported is used instead. 
+     * */
+    seq_aligner(double r, ENGINE e) : R(r), engine(e), xdrop(0), edits(NULL), 
+        ws(aligner_workspace::acquire()) {
+        if (!simd_engine::supported(engine)) {
+            engine = simd_engine::widest();
+            LOG("engine %s not supported, use %s\n", 
+                    engine_name(e), engine_name(engine));
+        }
+    };
+    /**
+     * Give the workspace back to the pool of the calling thread. 
+     * */
+    ~seq_aligner() { aligner_workspace::release(ws); }
     double R;                   //! ratio of difference allowed
+    ENGINE engine;              //! engine filling the DP band
+    int xdrop;                  //! X-drop of the adaptive band, 0 for all
     int len_a;                  //! max possible length of match in seg_a
     int len_b;                  //! max possible length of match in seg_b
     int max_dst;                //! max distance allowed
     int matlen_a;               //! length of match in seg_a
     int matlen_b;               //! length of match in seg_b
-    edit edits[MAXN + MAXM];//! edits to transform seg_a to seg_b[beg:end]
+    edit *edits;                //! edits to transform seg_a to seg_b[beg:end]
     int nedit;                  //! number of edits
-    state mat[MAXN][MAXM];      // DP matrix 
+    size_t ncell;               //! cells computed by the last alignment
+    int nanchor;                //! seed hits chained by align_chained
 
     /**
      * Align two sequences defined by seq_accessor. It is the main
@@ -88,104 +201,334 @@ public:
      * each other. This function return -1 if fail, or the length of match if
      * succeed. If the alignment is successful, detailed information about the
      * alignment will be available as public-accessible class members.
+     * A and B are seq_accessor, or fwd_accessor or rev_accessor when the
+     * direction is known at compile time, which takes the direction
+     * branches out of the inner loops, or bin_accessor to align a binary
+     * sequence in place.
      **/
-    int align(seq_accessor *seg_a, seq_accessor *seg_b) {
-        // work out parameters
-        if (seg_b->length() >= seg_a->length()) { 
-            len_a = seg_a->length();
-            max_dst = 1 + (int)(len_a * R);
-            len_b = std::min(seg_b->length(), len_a + max_dst);
+    template <class A, class B>
+    int align(A *seg_a, B *seg_b) {
+        return run(seg_a, seg_b, true);
+    };
+    /**
+     * Score-only version of align. The band is computed with rolling rows
+     * and nothing is kept for the traceback, so no edits are produced:
+     * only matlen_a, matlen_b, final_cost and get_cost on the last row and
+     * column are available. It is much lighter on memory when most hits are
+     * rejected; call align on the same segments to get the edits of a hit
+     * once it is accepted. 
+     **/
+    template <class A, class B>
+    int align_score(A *seg_a, B *seg_b) {
+        return run(seg_a, seg_b, false);
+    };
+    /**
+     * Piecewise version of align for long segments. Hits of the spaced seed
+     * sd_pat between seg_a and seg_b are chained co-linearly from the
+     * origin, the gaps between consecutive hits are aligned globally, and
+     * the part after the last hit with align. The edits of all the pieces
+     * are spliced into edits, so the result is used as the one of align,
+     * except for get_cost. The DP is then roughly the sum of the gaps
+     * squared instead of the band times the length of the segments. 
+     **/
+    template <class A, class B>
+    int align_chained(A *seg_a, B *seg_b, t_seed sd_pat) {
+        nanchor = chain(seg_a, seg_b, sd_pat);
+        if (nanchor == 0) return run(seg_a, seg_b, true);
+
+        std::vector<edit> &out = ws->chain;
+        out.clear();
+        int cost = 0, ia = 0, jb = 0;
+        for (int k = 0; k < nanchor; ++k) {
+            const anchor &an = ws->anchors[k];
+            cost += close_gap(seg_a, ia, an.i - ia, seg_b, jb, an.j - jb);
+            for (int t = 0; t < N_SEQ_WORD; ++t) {
+                char c = seg_a->at(an.i + t);
+                char d = seg_b->at(an.j + t);
+                edit e = {MATCH, d};
+                out.push_back(e);
+                cost += match(c, d);
+            }
+            ia = an.i + N_SEQ_WORD;
+            jb = an.j + N_SEQ_WORD;
+        }
+
+        // free end after the last hit, short ones are aligned in full
+        int la = seg_a->length() - ia, lb = seg_b->length() - jb;
+        int ma = 0, mb = 0;
+        if (std::min(la, lb) <= CHAIN_GAP) {
+            if (lb >= la) lb = std::min(lb, la + 1 + (int)(la * R));
+            else la = std::min(la, lb + 1 + (int)(lb * R));
+            cost += close_gap(seg_a, ia, la, seg_b, jb, lb, &ma, &mb);
         } else {
-            len_b = seg_b->length();
-            max_dst = 1 + (int)(len_b * R);
-            len_a = std::min(seg_a->length(), len_b + max_dst);
+            A ta = seg_a->sub(ia, la);
+            B tb = seg_b->sub(jb, lb);
+            if (run(&ta, &tb, true) < 0) return -1;
+            out.insert(out.end(), edits, edits + nedit);
+            cost += fcost;
+            la = len_a;
+            lb = len_b;
+            ma = matlen_a;
+            mb = matlen_b;
+        }
+        len_a = ia + la;
+        len_b = jb + lb;
+        matlen_a = ia + ma;
+        matlen_b = jb + mb;
+        fcost = cost;
+        edits = &out[0];
+        nedit = out.size();
+        if (fcost > matlen_b * R) return -1;
+        return matlen_b;
+    };
+    /**
+     * Score-only alignment of n pairs, seg_a[k] against seg_b[k], at once.
+     * Pairs are aligned one per lane by the inter-sequence engine, with the
+     * kernel of the SIMD engine of the aligner, or of the widest one
+     * supported by the CPU. Pairs with bands of similar widths are run
+     * together, longest first. The result of pair k, in res[k], is what
+     * align_score gives with the scalar engine. Pairs the 16-bit lanes
+     * cannot hold are aligned one by one with align_score. The aligner does
+     * not keep any of the alignments. Return the number of pairs aligned. 
+     **/
+    template <class A, class B>
+    int align_batch(A *seg_a, B *seg_b, int n, batch_result *res) {
+        ENGINE e = engine >= ENGINE_SSE ? engine : simd_engine::widest();
+        std::vector<batch_pair> &ps = ws->pairs;
+        ps.clear();
+        for (int k = 0; k < n; ++k) {
+            batch_pair p;
+            p.k = k;
+            bounds(&seg_a[k], &seg_b[k], &p.la, &p.lb, &p.md);
+            if (e >= ENGINE_SSE && p.la > 0 && p.lb > 0 
+                    && p.la + p.lb < batch_engine::INF) {
+                ps.push_back(p);
+                continue;
+            }
+            res[k].ret = align_score(&seg_a[k], &seg_b[k]);
+            res[k].matlen_a = matlen_a;
+            res[k].matlen_b = matlen_b;
+            res[k].cost = fcost;
         }
+        std::sort(ps.begin(), ps.end(), wider);
 
-        if (len_a >= (MAXN+MAXM) || max_dst >= MAXM) {
-            LOG("segment too long: %d\n", len_a);
-            return -1;
+        // bands at least half as wide as the widest one are run together
+        for (size_t g = 0, h; g < ps.size(); g = h) {
+            for (h = g+1; h < ps.size() && 2*ps[h].md >= ps[g].md; ++h) ;
+            ws->bt.search(seg_a, seg_b, &ps[g], h - g, R, e);
+            for (size_t t = g; t < h; ++t) {
+                batch_result &br = res[ps[t].k];
+                br.matlen_a = ps[t].ma;
+                br.matlen_b = ps[t].mb;
+                br.cost = ps[t].cost;
+                br.ret = ps[t].cost < 0 || ps[t].mb < ps[t].lb*(1-R) 
+                    ? -1 : ps[t].mb;
+            }
         }
 
-        init_cell();
+        int naligned = 0;
+        for (int k = 0; k < n; ++k) 
+            if (res[k].ret >= 0) ++naligned;
+        return naligned;
+    };
+    /**
+     * Get the cost of the alignment. It will return the correct value only
+     * after align is called and return true. 
+     * */
+    int final_cost() { return fcost; }
+    /**
+     * Get the cost of aligning seg_a[0:i] to seg_b[0:j]. The scalar engine
+     * and score-only alignments only keep the last row (i == len_a) and the
+     * last column (j == len_b) of the band, which are all what goal_cell
+     * needs. 
+     * */
+    int get_cost(int i, int j) { 
+        if (cur == ENGINE_SCALAR) 
+            return (i == len_a || j != len_b) ? cell(i, j) : ws->last_col[i];
+        return cur == ENGINE_BITVEC ? ws->bv.get_cost(i, j) 
+            : ws->sv.get_cost(i, j);
+    };
+private:
+    seq_aligner(const seq_aligner&);
+    seq_aligner& operator=(const seq_aligner&);
+    ENGINE cur;                 // engine of the last alignment
+    int fcost;                  // cost of the last alignment
+    bool store;                 // keep what the traceback needs
+    aligner_workspace *ws;      // buffers, from the pool of the thread
+    // lengths of seg_a and seg_b that may match, and the max distance
+    template <class A, class B>
+    void bounds(A *seg_a, B *seg_b, 
+            int *pla, int *plb, int *pmd) {
+        if (seg_b->length() >= seg_a->length()) { 
+            *pla = seg_a->length();
+            *pmd = 1 + (int)(*pla * R);
+            *plb = std::min(seg_b->length(), *pla + *pmd);
+        } else {
+            *plb = seg_b->length();
+            *pmd = 1 + (int)(*plb * R);
+            *pla = std::min(seg_a->length(), *plb + *pmd);
+        }
+    };
+    // align seg_a to seg_b, with traceback if tb is set
+    template <class A, class B>
+    int run(A *seg_a, B *seg_b, bool tb) {
+        // work out parameters
+        bounds(seg_a, seg_b, &len_a, &len_b, &max_dst);
 
-        if (!search(seg_a, seg_b)) return -1;
+        // 16-bit lanes cannot hold the costs of very long segments
+        store = tb;
+        nedit = 0;
+        cur = engine;
+        if (cur >= ENGINE_SSE && len_a + len_b >= simd_engine::INF) 
+            cur = ENGINE_BITVEC;
+
+        if (cur == ENGINE_SCALAR) {
+            init_cell();
+            if (!search(seg_a, seg_b)) return -1;
+        } else if (cur == ENGINE_BITVEC) {
+            bool ok = ws->bv.search(seg_a, seg_b, len_a, len_b, max_dst, R, 
+                    xdrop, store);
+            ncell = ws->bv.ncell;
+            if (!ok) return -1;
+        } else {
+            bool ok = ws->sv.search(seg_a, seg_b, len_a, len_b, max_dst, R, 
+                    cur, store);
+            ncell = ws->sv.ncell;
+            if (!ok) return -1;
+        }
 
         goal_cell();
-        if (matlen_b < len_b*(1-R)) return -1;
-        nedit = 0;
-        find_path(matlen_a, matlen_b, seg_b);
+        fcost = get_cost(matlen_a, matlen_b);
+        if (matlen_b < len_b*(1-R) || fcost >= INF) return -1;
+        if (!store) return matlen_b;
+        if (ws->edits.size() <= (size_t)(matlen_a + matlen_b)) 
+            ws->edits.resize(matlen_a + matlen_b + 1);
+        edits = &ws->edits[0];
+        if (cur == ENGINE_SCALAR)
+            find_path(matlen_a, matlen_b, seg_b);
+        else
+            trace_path(matlen_a, matlen_b, seg_a, seg_b);
 
 #ifdef DEBUG_ALIGNER
-        print_matrix(seg_a, seg_b);
+        if (cur != ENGINE_SCALAR) print_matrix(seg_a, seg_b);
         printf("(%d, %d)\n", matlen_a, matlen_b);
         printf("len_a: %d, len_b: %d\n", len_a, len_b);
 #endif
 
         return matlen_b;
     };
-    /**
-     * Get the cost of the alignment. It will return the correct value only
-     * after align is called and return true. 
-     * */
-    int final_cost() { return get_cost(matlen_a, matlen_b); }
-    int get_cost(int i, int j) { return mat[i][j-i+max_dst].cost; };
-    void set_cost(int i, int j, int v) { mat[i][j-i+max_dst].cost = v; };
-    int get_parent(int i, int j) { return mat[i][j-i+max_dst].parent; }
-    void set_parent(int i, int j, int p) { mat[i][j-i+max_dst].parent = p;}
-private:
+    // scalar engine
+    int width;                  // width of the band, 2*max_dst+1
+    int tstride;                // bytes of a band row of parents
+    static const int INF = INT_MAX / 2;     // cost out of the adaptive band
     int match(char c, char d) { return c != d; };
     int indel(char c) { return 1; };
     // translate index into rectangle matrix to index into diagonal stripe
+    int& cell(int i, int j) { return ws->rows[(i&1)*width + j-i+max_dst]; };
+    int get_parent(int i, int j) { 
+        int k = j-i+max_dst;
+        return (ws->trace[(size_t)i*tstride + (k>>2)] >> ((k&3)<<1)) & 0x3;
+    }
+    void set_parent(int i, int j, int p) { 
+        int k = j-i+max_dst;
+        ws->trace[(size_t)i*tstride + (k>>2)] |= p << ((k&3)<<1);
+    }
     void init_cell() {
-        for (int i = 1; i <= max_dst; ++i) {
-            set_cost(i, 0, i);
-            set_parent(i, 0, DELETE);
-        }
+        width = 2*max_dst + 1;
+        tstride = (width + 3) >> 2;
+        if (ws->rows.size() < (size_t)(2*width)) ws->rows.resize(2*width);
+        if (ws->last_col.size() < (size_t)(len_a+1)) 
+            ws->last_col.resize(len_a+1);
+        if (store && ws->trace.size() < (size_t)(len_a+1) * tstride) 
+            ws->trace.resize((size_t)(len_a+1) * tstride);
+        if (store) memset(&ws->trace[0], 0, tstride);
         for (int j = 1; j <= max_dst; ++j) {
-            set_cost(0, j, j);
-            set_parent(0, j, INSERT);
+            cell(0, j) = j;
+            if (store) set_parent(0, j, INSERT);
         }
-        set_cost(0, 0, 0);
-        set_parent(0, 0, 0);
+        cell(0, 0) = 0;
+        if (len_b <= max_dst) ws->last_col[0] = len_b;
     };
-    bool search(seq_accessor *seg_a, seq_accessor *seg_b) {
+    /*
+     * Fill the band row by row. With an X-drop, a row is only computed
+     * from the first to one past the last live cell of the previous row,
+     * then extended by insertions while they stay in reach, and trimmed to
+     * the cells within xdrop of its best one. Cells out of the live range
+     * cost INF. 
+     */
+    template <class A, class B>
+    bool search(A *seg_a, B *seg_b) {
         seg_a->reset(0);     // start from the first
-        int best_cost = len_a;
-        int best_pos = 0;
+        int best_cost = 0;
+        // live cells of the previous row
+        int lo = 0;
+        int hi = std::min(len_b, max_dst);
+        if (xdrop && hi > xdrop) cell(0, (hi = xdrop) + 1) = INF;
+        int beg = 0, last = hi;
+        ncell = 0;
         for (int i=1; i<=len_a; ++i) {
-            best_cost = len_a;
             char c = seg_a->next();
-            int beg = std::max(1, i - max_dst);
+            int thr = best_cost + xdrop;
+            best_cost = INF;
+            beg = std::max(std::max(1, i - max_dst), lo);
             int end = std::min(len_b, i + max_dst);
+            last = std::min(end, hi + 1);
+            if (store) memset(&ws->trace[(size_t)i*tstride], 0, tstride);
+            if (i <= max_dst) {
+                cell(i, 0) = best_cost = i;
+                if (store) set_parent(i, 0, DELETE);
+            }
+            if (beg > std::max(1, i - max_dst)) cell(i, beg-1) = INF;
             seg_b->reset(beg-1);     // start from the beg-th element
-            for (int j=beg; j<=end; ++j) {
+            for (int j=beg; j<=last; ++j) {
                 char d = seg_b->next();
                 int t; 
-                int cost = get_cost(i-1, j-1) + match(c, d);
+                int cost = cell(i-1, j-1) + match(c, d);
                 int src = MATCH;
-                if (i-j<max_dst && (t=get_cost(i,j-1)+indel(c)) < cost) {
+                if (i-j<max_dst && (t=cell(i,j-1)+indel(c)) < cost) {
                     cost = t;
                     src = INSERT;
                 }
-                if (j-i<max_dst && (t=get_cost(i-1,j)+indel(d)) < cost) {
+                if (j-i<max_dst && (t=cell(i-1,j)+indel(d)) < cost) {
                     cost = t;
                     src = DELETE;
                 }
-                set_cost(i, j, cost);
-                set_parent(i, j, src);
-                if (cost <= best_cost) {
-                    best_cost = cost;
-                    best_pos = j;
-                }
+                cell(i, j) = cost;
+                if (store) set_parent(i, j, src);
+                if (cost < best_cost) best_cost = cost;
+            }
+            // past the previous row, only reachable by insertions
+            for (; last < end && cell(i, last) < thr; ++last) {
+                cell(i, last+1) = cell(i, last) + 1;
+                if (store) set_parent(i, last+1, INSERT);
             }
+            ncell += last - beg + 1;
+            if (last < end) cell(i, last+1) = INF;
 #ifdef DEBUG_ALIGNER
             LOG("i = %d, best_cost = %d\n", i, best_cost);
 #endif
+            if (end == len_b) 
+                ws->last_col[i] = last == len_b ? cell(i, len_b) : INF;
+            if (xdrop) {
+                lo = beg;
+                hi = last;
+                while (lo < last && cell(i, lo) > best_cost + xdrop) ++lo;
+                while (hi > lo && cell(i, hi) > best_cost + xdrop) --hi;
+                if (i <= max_dst && i <= best_cost + xdrop) lo = 0;
+            } else {
+                hi = end;
+            }
             // early failure 
-            if (i > 10 && get_cost(i, i) > i*R) {
+            if (i > 10 && i <= len_b 
+                    && (xdrop ? best_cost : cell(i, i)) > i*R) {
                 return false;
             }
         }
+        // out of the live range on the last row
+        for (int j = std::max(1, len_a - max_dst); j < beg; ++j) 
+            cell(len_a, j) = INF;
+        for (int j = last + 1; j <= std::min(len_b, len_a + max_dst); ++j) 
+            cell(len_a, j) = INF;
         return true;
     };
     void goal_cell() {
@@ -211,7 +554,172 @@ private:
             }
         }
     };
-    void find_path(int i, int j, seq_accessor *seg_b) {
+    // piecewise alignment
+    static const int CHAIN_GAP = 256;   // max gap between chained hits
+    static const int CHAIN_WIN = 64;    // hits looked back for the chain
+    static const int CHAIN_OCC = 8;     // seeds with more hits are ignored
+    /*
+     * Collect the hits of sd_pat between seg_a and seg_b inside the band,
+     * and chain them co-linearly from the origin. The best chain is left at
+     * the front of ws->anchors, return its length. 
+     */
+    template <class A, class B>
+    int chain(A *seg_a, B *seg_b, t_seed sd_pat) {
+        int lb = seg_b->length();
+        int md = 1 + (int)(lb * R);
+        int la = std::min(seg_a->length(), lb + md);
+        t_seed mask = seed_mask(sd_pat);
+        std::vector<std::pair<t_seed, int> > &km = ws->kmers;
+        km.clear();
+        t_seed code = 0;
+        for (int i = 0; i < la; ++i) {
+            char c = seg_a->at(i);
+            code = code << 2 | C2I(c);
+            if (i >= N_SEQ_WORD-1 && (code & mask))
+                km.push_back(std::make_pair(code & mask, i-N_SEQ_WORD+1));
+        }
+        std::sort(km.begin(), km.end());
+
+        std::vector<anchor> &an = ws->anchors;
+        an.clear();
+        code = 0;
+        for (int j = 0; j < lb; ++j) {
+            char d = seg_b->at(j);
+            code = code << 2 | C2I(d);
+            if (j < N_SEQ_WORD-1 || !(code & mask)) continue;
+            std::vector<std::pair<t_seed, int> >::iterator lo, hi;
+            lo = std::lower_bound(km.begin(), km.end(), 
+                    std::make_pair(code & mask, INT_MIN));
+            hi = std::upper_bound(lo, km.end(), 
+                    std::make_pair(code & mask, INT_MAX));
+            if (hi - lo > CHAIN_OCC) continue;
+            for (; lo != hi; ++lo) {
+                anchor a = {lo->second, j-N_SEQ_WORD+1, -1, -1};
+                if (abs(a.j - a.i) <= md) an.push_back(a);
+            }
+        }
+        std::sort(an.begin(), an.end(), by_pos);
+
+        int best = -1, best_score = 0;
+        for (int k = 0; k < (int)an.size(); ++k) {
+            anchor &a = an[k];
+            if (std::max(a.i, a.j) <= CHAIN_GAP && co_linear(0, 0, a)) 
+                a.score = N_SEQ_WORD;
+            for (int p = k-1; p >= std::max(0, k-CHAIN_WIN); --p) {
+                const anchor &q = an[p];
+                if (q.score < 0 || q.score + N_SEQ_WORD <= a.score
+                        || q.i + N_SEQ_WORD > a.i || q.j + N_SEQ_WORD > a.j
+                        || std::max(a.i-q.i, a.j-q.j) > CHAIN_GAP+N_SEQ_WORD
+                        || !co_linear(q.i, q.j, a)) 
+                    continue;
+                a.score = q.score + N_SEQ_WORD;
+                a.prev = p;
+            }
+            if (a.score > best_score) {
+                best_score = a.score;
+                best = k;
+            }
+        }
+
+        // reverse the links of the best chain, then move it to the front
+        int next = -1;
+        while (best >= 0) {
+            int p = an[best].prev;
+            an[best].prev = next;
+            next = best;
+            best = p;
+        }
+        int n = 0;
+        while (next >= 0) {
+            int k = next;
+            next = an[k].prev;
+            an[n++] = an[k];
+        }
+        return n;
+    };
+    static bool by_pos(const anchor &x, const anchor &y) {
+        return x.i < y.i || (x.i == y.i && x.j < y.j);
+    };
+    // batch: wider bands first, then longer pairs
+    static bool wider(const batch_pair &x, const batch_pair &y) {
+        return x.md > y.md || (x.md == y.md && x.la + x.lb > y.la + y.lb);
+    };
+    // hit a can follow (i, j) with a drift of the diagonal within R
+    bool co_linear(int i, int j, const anchor &a) {
+        int gap = std::max(a.i - i, a.j - j);
+        return abs((a.j - a.i) - (j - i)) <= gap * R + 1;
+    };
+    // mask of a spaced seed, from the layout of dna_seq::encode to the
+    // rolling codes of chain, the first base in the highest bits 
+    static t_seed seed_mask(t_seed sd_pat) {
+        t_seed mask = 0;
+        for (int t = 0; t < N_SEQ_WORD; ++t) {
+            t_seed b = (sd_pat >> ((t>>2)*8 + 6 - ((t&3)<<1))) & 0x3;
+            mask |= b << ((N_SEQ_WORD-1-t) << 1);
+        }
+        return mask;
+    };
+    /*
+     * Align seg_a[ia:ia+ga] to seg_b[jb:jb+gb] globally, append the edits
+     * to ws->chain and return the cost. If pea and peb are given, the end is
+     * free as in goal_cell, and the lengths matched are returned in them. 
+     */
+    template <class A, class B>
+    int close_gap(A *seg_a, int ia, int ga, 
+            B *seg_b, int jb, int gb, 
+            int *pea = NULL, int *peb = NULL) {
+        int w = gb + 1;
+        std::vector<int> &dp = ws->gap;
+        if (dp.size() < (size_t)(ga+1) * w) dp.resize((size_t)(ga+1) * w);
+        for (int j = 0; j <= gb; ++j) dp[j] = j;
+        for (int i = 1; i <= ga; ++i) {
+            char c = seg_a->at(ia+i-1);
+            dp[i*w] = i;
+            for (int j = 1; j <= gb; ++j) {
+                char d = seg_b->at(jb+j-1);
+                dp[i*w+j] = std::min(dp[(i-1)*w+j-1] + match(c, d), 
+                        std::min(dp[i*w+j-1], dp[(i-1)*w+j]) + 1);
+            }
+        }
+        int i = ga, j = gb;
+        if (pea) {
+            if (ga > gb) {
+                for (int k = i = gb; k <= ga; ++k) 
+                    if (dp[k*w+gb] < dp[i*w+gb]) i = k;
+            } else {
+                for (int k = j = ga; k <= gb; ++k) 
+                    if (dp[ga*w+k] < dp[ga*w+j]) j = k;
+            }
+            *pea = i;
+            *peb = j;
+        }
+        int cost = dp[i*w+j];
+        // ties are broken as in search: MATCH, INSERT, DELETE
+        std::vector<edit> &out = ws->chain;
+        size_t from = out.size();
+        while (i > 0 || j > 0) {
+            char c = i > 0 ? seg_a->at(ia+i-1) : 0;
+            char d = j > 0 ? seg_b->at(jb+j-1) : 0;
+            edit e = {DELETE, 0};
+            if (i > 0 && j > 0 
+                    && dp[(i-1)*w+j-1] + match(c, d) == dp[i*w+j]) {
+                e.op = MATCH;
+                e.val = d;
+                --i; --j;
+            } else if (j > 0 && dp[i*w+j-1] + 1 == dp[i*w+j]) {
+                e.op = INSERT;
+                e.val = d;
+                --j;
+            } else {
+                --i;
+            }
+            out.push_back(e);
+        }
+        std::reverse(out.begin() + from, out.end());
+        return cost;
+    };
+    template <class B>
+    void find_path(int i, int j, B *seg_b) {
         int p = get_parent(i, j);
         if (p == MATCH) {
             find_path(i-1, j-1, seg_b);
@@ -232,9 +740,42 @@ private:
         }
     };
     /*
-     * Print DP matrix for debuging. 
+     * Recover the path from the costs, which is what the bit-parallel
+     * and SIMD engines keep. Ties are broken as in search: MATCH, INSERT,
+     * DELETE.
+     * Bases are compared by code as the engine does. 
+     */
+    template <class A, class B>
+    void trace_path(int i, int j, A *seg_a, B *seg_b) {
+        int cost = get_cost(i, j);
+        while (i > 0 || j > 0) {
+            int t;
+            char c = i > 0 ? seg_a->at(i-1) : 0;
+            char d = j > 0 ? seg_b->at(j-1) : 0;
+            if (i > 0 && j > 0 
+                    && (t = get_cost(i-1, j-1)) + (C2I(c) != C2I(d)) == cost) {
+                edits[nedit].op = MATCH;
+                edits[nedit].val = d;
+                --i; --j;
+            } else if (j > 0 && (t = get_cost(i, j-1)) + 1 == cost) {
+                edits[nedit].op = INSERT;
+                edits[nedit].val = d;
+                --j;
+            } else {
+                t = get_cost(i-1, j);
+                edits[nedit].op = DELETE;
+                --i;
+            }
+            cost = t;
+            ++nedit;
+        }
+        std::reverse(edits, edits + nedit);
+    };
+    /*
+     * Print DP matrix for debuging. The scalar engine does not keep it. 
      */
-    void print_matrix(seq_accessor *seg_a, seq_accessor *seg_b) {
+    template <class A, class B>
+    void print_matrix(A *seg_a, B *seg_b) {
         printf(" \t \t");
         for (int j = 1; j <= len_b; ++j) {
             printf("%c\t", seg_b->at(j-1));
@@ -254,9 +795,8 @@ private:
 };
 
 /**
- * This is typedef of an instantialization of seq_aligner with default
- * parameters. It is the actual aligner being used. 
+ * This is typedef of the aligner being used. 
  * */
-typedef seq_aligner<MAX_READ_LEN+MAX_DIFF_LEN, MAX_DIFF_LEN> t_aligner;
+typedef seq_aligner t_aligner;
 
 #endif
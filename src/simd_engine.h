@@ -0,0 +1,260 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  simd_engine.h
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 11:05:17 AM
+ *
+ *    Description:  anti-diagonal SIMD engine of seq_aligner with runtime
+ *    dispatch among SSE4.1, AVX2 and AVX-512BW
+ *
+ *       Revision:  none
+ *
+ *
+ * ===========================================================================
+ */
+
+#ifndef SIMD_ENGINE_H
+#define SIMD_ENGINE_H
+
+#include	<assert.h>
+#include	<algorithm>
+#include	<vector>
+#include	"dna_seq.h"
+#include	"common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#include	<immintrin.h>
+#endif
+
+/**
+ * SIMD engine of the banded edit distance. Cells on one anti-diagonal
+ * (i+j = k) do not depend on each other, so the band is filled one
+ * anti-diagonal at a time with 16-bit saturated lanes. Cell (i, j) of
+ * anti-diagonal k is stored at x = (j-i+E-(k&1))/2, so that its three
+ * parents are at x-1, x or x+1 of the two previous anti-diagonals, and
+ * both sequences are read contiguously (seg_a reversed). The costs are the
+ * same as those of the scalar engine, cell by cell. In score-only mode, only
+ * three anti-diagonals are kept, plus the costs of the last row and column.
+ *
+ * The vector kernel is chosen at runtime by CPUID, so the same binary runs
+ * on every x86 node and uses the widest vector unit there.
+ **/
+class simd_engine {
+public:
+    typedef unsigned short t_cost;
+    //! cost of cells outside the band, also the limit of len_a+len_b
+    static const int INF = 0xFFFF;
+    size_t ncell;               //! cells computed by the last search
+
+    /**
+     * Check if engine e can run on this CPU.
+     **/
+    static bool supported(ENGINE e) {
+#ifdef SIMD_X86
+        if (e == ENGINE_SSE) return __builtin_cpu_supports("sse4.1");
+        if (e == ENGINE_AVX2) return __builtin_cpu_supports("avx2");
+        if (e == ENGINE_AVX512) return __builtin_cpu_supports("avx512bw");
+#else
+        if (e >= ENGINE_SSE) return false;
+#endif
+        return e == ENGINE_SCALAR || e == ENGINE_BITVEC;
+    }
+
+    /**
+     * The widest SIMD engine supported by this CPU, or the bit-parallel
+     * engine if there is none.
+     **/
+    static ENGINE widest() {
+        if (supported(ENGINE_AVX512)) return ENGINE_AVX512;
+        if (supported(ENGINE_AVX2)) return ENGINE_AVX2;
+        if (supported(ENGINE_SSE)) return ENGINE_SSE;
+        return ENGINE_BITVEC;
+    }
+
+    /**
+     * Compute the band of seg_a[0:la] against seg_b[0:lb] with maximum
+     * diagonal distance md using the kernel of engine e. Return false on
+     * early failure, i.e., the cost on the main diagonal exceeds ratio r of
+     * its length. All anti-diagonals are kept for the traceback only if
+     * store is set.
+     **/
+    template <class A, class B>
+    bool search(A *seg_a, B *seg_b, int la, int lb,
+            int md, double r, ENGINE e, bool store = true) {
+        row_kernel kernel = get_kernel(e);
+        assert(kernel != NULL && la + lb < INF);
+        len_a = la;
+        len_b = lb;
+        max_dst = md;
+        stored = store;
+        ncell = 0;
+        E = max_dst + (max_dst & 1);
+        stride = E + 1 + 2*PAD;
+        rows.resize((size_t)(stored ? len_a + len_b + 1 : 3) * stride);
+        if (!stored) {
+            last_row.resize(len_b+1);
+            last_col.resize(len_a+1);
+        }
+
+        // seg_a reversed, seg_b forward, both as base codes
+        ra.resize(len_a + 2*PAD);
+        rb.resize(len_b + 2*PAD);
+        for (int i = 0; i < len_a; ++i) {
+            char c = seg_a->at(len_a-1-i);
+            ra[PAD+i] = C2I(c);
+        }
+        for (int j = 0; j < len_b; ++j) {
+            char d = seg_b->at(j);
+            rb[PAD+j] = C2I(d);
+        }
+
+        for (int k = 0; k <= len_a + len_b; ++k) {
+            int p = k & 1;
+            int tlo = std::max(-max_dst, std::max(-k, k - 2*len_a));
+            int thi = std::min(max_dst, std::min(k, 2*len_b - k));
+            if ((tlo - k) & 1) ++tlo;
+            if ((thi - k) & 1) --thi;
+            if (tlo > thi) continue;
+            int xlo = (tlo + E - p) / 2;
+            int xhi = (thi + E - p) / 2;
+            t_cost *out = &rows[row_off(k)];
+            ncell += xhi - xlo + 1;
+            int xend = xhi + 1;
+            if (k >= 2) {
+                const t_cost *prev = &rows[row_off(k-1)] + xlo - 1 + p;
+                kernel(&rows[row_off(k-2)] + xlo, prev, prev + 1,
+                        &ra[PAD + len_a - (k-p+E)/2 + xlo],
+                        &rb[PAD + (k+p-E)/2 - 1 + xlo],
+                        out + xlo, xhi - xlo + 1);
+                xend = xlo + (xhi - xlo + lanes(e)) / lanes(e) * lanes(e);
+            }
+            if (tlo == -k) out[xlo] = k;    // j = 0
+            if (thi == k) out[xhi] = k;     // i = 0
+            out[xlo-1] = INF;
+            for (int x = xhi + 1; x <= xend; ++x) out[x] = INF;
+            if (!stored) {
+                if (tlo == k - 2*len_a) last_row[k - len_a] = out[xlo];
+                if (thi == 2*len_b - k) last_col[k - len_b] = out[xhi];
+            }
+
+            // early failure
+            int i = k >> 1;
+            if (!p && i > 10 && i <= len_b && i <= len_a
+                    && get_cost(i, i) > i*r)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Cost of aligning seg_a[0:i] with seg_b[0:j], which is in the band or
+     * right next to it. In score-only mode, only the last row and column,
+     * and the cells of the latest anti-diagonals are available.
+     **/
+    int get_cost(int i, int j) {
+        if (!stored && (i == len_a || j == len_b)) 
+            return i == len_a ? last_row[j] : last_col[i];
+        int k = i + j;
+        return rows[row_off(k) + (j - i + E - (k&1))/2];
+    }
+private:
+    //! widest vector in 16-bit lanes, and padding of every array
+    static const int PAD = 32;
+
+    /*
+     * Fill n cells of an anti-diagonal from the diagonal, insertion and
+     * deletion parents and the base codes of the two sequences. It may
+     * write up to a vector past the n cells.
+     */
+    typedef void (*row_kernel)(const t_cost *dg, const t_cost *in,
+            const t_cost *dl, const t_cost *pa, const t_cost *pb,
+            t_cost *out, int n);
+
+    static int lanes(ENGINE e) {
+        return e == ENGINE_AVX512 ? 32 : (e == ENGINE_AVX2 ? 16 : 8);
+    }
+
+    static row_kernel get_kernel(ENGINE e) {
+#ifdef SIMD_X86
+        if (e == ENGINE_SSE) return row_sse;
+        if (e == ENGINE_AVX2) return row_avx2;
+        if (e == ENGINE_AVX512) return row_avx512;
+#endif
+        return NULL;
+    }
+
+#ifdef SIMD_X86
+    __attribute__((target("sse4.1")))
+    static void row_sse(const t_cost *dg, const t_cost *in,
+            const t_cost *dl, const t_cost *pa, const t_cost *pb,
+            t_cost *out, int n) {
+        const __m128i one = _mm_set1_epi16(1);
+        for (int x = 0; x < n; x += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(pa+x));
+            __m128i b = _mm_loadu_si128((const __m128i*)(pb+x));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dg+x));
+            __m128i h = _mm_min_epu16(_mm_loadu_si128((const __m128i*)(in+x)),
+                    _mm_loadu_si128((const __m128i*)(dl+x)));
+            __m128i m = _mm_andnot_si128(_mm_cmpeq_epi16(a, b), one);
+            _mm_storeu_si128((__m128i*)(out+x), _mm_min_epu16(
+                        _mm_adds_epu16(d, m), _mm_adds_epu16(h, one)));
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void row_avx2(const t_cost *dg, const t_cost *in,
+            const t_cost *dl, const t_cost *pa, const t_cost *pb,
+            t_cost *out, int n) {
+        const __m256i one = _mm256_set1_epi16(1);
+        for (int x = 0; x < n; x += 16) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(pa+x));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(pb+x));
+            __m256i d = _mm256_loadu_si256((const __m256i*)(dg+x));
+            __m256i h = _mm256_min_epu16(
+                    _mm256_loadu_si256((const __m256i*)(in+x)),
+                    _mm256_loadu_si256((const __m256i*)(dl+x)));
+            __m256i m = _mm256_andnot_si256(_mm256_cmpeq_epi16(a, b), one);
+            _mm256_storeu_si256((__m256i*)(out+x), _mm256_min_epu16(
+                        _mm256_adds_epu16(d, m), _mm256_adds_epu16(h, one)));
+        }
+    }
+
+    __attribute__((target("avx512bw")))
+    static void row_avx512(const t_cost *dg, const t_cost *in,
+            const t_cost *dl, const t_cost *pa, const t_cost *pb,
+            t_cost *out, int n) {
+        const __m512i one = _mm512_set1_epi16(1);
+        for (int x = 0; x < n; x += 32) {
+            __m512i a = _mm512_loadu_si512((const void*)(pa+x));
+            __m512i b = _mm512_loadu_si512((const void*)(pb+x));
+            __m512i d = _mm512_loadu_si512((const void*)(dg+x));
+            __m512i h = _mm512_min_epu16(_mm512_loadu_si512((const void*)(in+x)),
+                    _mm512_loadu_si512((const void*)(dl+x)));
+            __m512i m = _mm512_maskz_mov_epi16(
+                    _mm512_cmpneq_epi16_mask(a, b), one);
+            _mm512_storeu_si512((void*)(out+x), _mm512_min_epu16(
+                        _mm512_adds_epu16(d, m), _mm512_adds_epu16(h, one)));
+        }
+    }
+#endif
+
+    size_t row_off(int k) { 
+        return (size_t)(stored ? k : k % 3) * stride + PAD; 
+    }
+
+    int len_a;
+    int len_b;
+    int max_dst;
+    int E;                      // max_dst rounded up to even
+    int stride;                 // distance between two anti-diagonals
+    bool stored;                // all anti-diagonals kept for traceback
+    std::vector<t_cost> rows;   // costs of all anti-diagonals
+    std::vector<t_cost> ra;     // codes of seg_a reversed, padded
+    std::vector<t_cost> rb;     // codes of seg_b, padded
+    std::vector<int> last_row;  // score-only: cost at (len_a, j)
+    std::vector<int> last_col;  // score-only: cost at (i, len_b)
+};
+
+#endif
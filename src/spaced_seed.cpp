@@ -19,6 +19,7 @@
 #include    <fcntl.h>
 #include    <unistd.h>
 #include	<assert.h>
+#include	<pthread.h>
 #include	<string.h>
 #include	<stdio.h>
 #include	<math.h>
@@ -26,26 +27,36 @@
 #include	<deque>
 #include	<list>
 #include	<fstream>
+#include	<string>
 
 #include	"dna_seq.h"
 #include	"seq_aligner.h"
 #include	"common.h"
 #include	"ref_seq.h"
+#include	"seed_index.h"
+#include	"seed_file.h"
 
 #define STRONG 3
 #define SEQ_THRESHOLD 500
 #define N_SEGMENT 100
 #define N_TRIAL 50
+//! max distance between two diagonals of the same seed hit bin
+#define DIAG_SLACK 32
+//! max number of diagonals aligned per segment when voting
+#define N_VOTED 8
+//! segments a thread takes at once when not aligning blocks
+#define SEG_CHUNK 64
 #define MAX_PAT_LEN N_SEQ_WORD
 #define handle_error(msg) do { perror(msg); exit(EXIT_FAILURE); } while (0)
 
 #ifdef DBG
 size_t _ntrials = 0;
 size_t _nfound = 0;
+size_t _nhits = 0;
 #endif
 
 const char *usage_str = "usage: %s [options] bin seedfile\n"
-    "options: [-f:r:d:m:t:lh]\n"
+    "options: [-f:r:d:m:t:A:x:b:M:v:P:w:j:s:olh]\n"
     "   -h          Get help and usage.\n"
     "   -f file     Use the string from file as starting reference. Only\n"
     "               the first 2 lines of the file read be read, the 1st\n" 
@@ -58,35 +69,143 @@ const char *usage_str = "usage: %s [options] bin seedfile\n"
     "   -d dumpfile Dump matched segments.\n"
     "   -m nround   Maximum number of round of iteration.\n"
     "   -t ntrials  Number of seeding trial for each segment.\n"
-    "   -l          Lock reference during iteration.\n";
+    "   -l          Lock reference during iteration.\n"
+    "   -B          Cast the votes of the segments of a round in batch at\n"
+    "               its end, sorted by position, instead of one segment\n"
+    "               at a time.\n"
+    "   -A engine   Alignment engine: scalar, bitvec (default), sse, avx2,\n"
+    "               avx512 or simd (the widest one supported by the CPU).\n"
+    "   -x xdrop    Adaptive band of the scalar and bitvec engines, drop\n"
+    "               cells costing xdrop more than the best one of their\n"
+    "               row (0, the whole band, by default).\n"
+    "   -b nreads   Filter the seed hits of nreads segments at once with\n"
+    "               the inter-sequence SIMD aligner (0, one hit at a time,\n"
+    "               by default).\n"
+    "   -o          Use one pattern of seedfile per round, instead of all\n"
+    "               of them at once.\n"
+    "   -M maxocc   Mask the seeds found at more than maxocc positions of\n"
+    "               the reference, i.e., repeats (0, none, by default).\n"
+    "   -v minvotes Gather the seed hits of all the trials of a segment,\n"
+    "               bin them by diagonal, and only align the best supported\n"
+    "               diagonals with at least minvotes hits (0, every hit in\n"
+    "               turn, by default).\n"
+    "   -P probes   Map the seeds at both ends of the segments of bin from\n"
+    "               probes, saved by seed_builder -r, instead of rolling\n"
+    "               them at every round.\n"
+    "   -w window   Only index and probe the minimizers of every window\n"
+    "               consecutive seeds, of the reference and of the trials\n"
+    "               of a segment (0, every seed, by default).\n"
+    "   -j nthreads Align the segments of a round with nthreads threads,\n"
+    "               each with its own aligner (1 by default). They are\n"
+    "               applied in order after the round, so that the output\n"
+    "               is the same with any nthreads.\n"
+    "   -s file     Self-check every engine against scalar on the pairs of\n"
+    "               sequences in file (e.g. test/real_align.txt) and exit.\n";
 
 class seq_index {
 public:
-    seq_index(int i, int o) : id(i), offset(o) {};
+    seq_index(int i, int o, int n) : id(i), offset(o), ord(n) {};
     int id;             // the id-th sequence
     int offset;         // offset into binary file 
+    int ord;            // the ord-th segment of binary file, even if ignored
 };
 
-// spaced seed
-unsigned seed = 0;
+// spaced seed of the round, if only one pattern is used per round
+t_seed seed = 0;
+bool one_pattern = false;
 
 // buf for binary DNA sequence
 t_bseq *buf = NULL;
 // indices for binary DNA sequence
 std::list<seq_index> indices;  
+typedef std::list<seq_index>::iterator index_it;
+// size of the binary file, and number of segments in it
+size_t buf_len = 0;
+int nsegs = 0;
+
+// seeds at both ends of every segment mapped from a probe file, or NULL
+const t_seed *probe_tab = NULL;
+int probe_trials = 0;
 
-t_aligner *paligner = NULL;
 ref_seq *pref = NULL;
 
-// information of active segment
-t_bseq *seg_bin; 
-char seg_txt[MAX_SEQ_LEN];
-int seg_len;
-int seg_id = -1;
+// seedmap for reference sequence, of all the patterns used in the round
+multi_seed_index seedmap;
+std::vector<t_seed> seeds; 
+
+// engine of the aligner
+ENGINE engine = ENGINE_BITVEC;
+int xdrop = 0;
+
+// segments whose seed hits are filtered at once, 0 for none
+int batch_reads = 0;
+
+// seeds of more positions in the reference are masked, 0 for none
+int max_occ = 0;
+
+// min number of hits of a diagonal to be aligned, 0 for no voting
+int min_votes = 0;
+
+// window of the minimizers of the reference and the probes, 0 for none
+int window = 0;
 
-// seedmap for reference sequence
-hash_table seedmap(1<<20);
-std::vector<unsigned> seeds; 
+// threads aligning the segments of a round
+int nthreads = 1;
+
+// seed hit of a segment of a block, in the order try_align visits them
+typedef struct {
+    int read;           // segment in the block
+    int r_offset;       // offset into reference
+    int s_offset;       // offset into segment
+    int s_len;          // length of segment from s_offset
+    t_seed pattern;     // spaced seed pattern of the hit
+    bool forward;
+} candidate;
+
+// state of a thread aligning segments, see align_segments
+typedef struct {
+    t_aligner *paligner;
+    // information of active segment
+    t_bseq *seg_bin; 
+    int seg_len;
+    int seg_id;
+    // seed hits of the segments of a block, those of segment k from first[k]
+    std::vector<candidate> cands;
+    std::vector<int> first;
+    // current hit of every segment, and its hit passing the filter or -1
+    std::vector<int> cursor;
+    std::vector<int> pass;
+    // probes of the segment, and those kept by every pattern
+    std::vector<t_seed> probes;
+    std::vector<char> kept;
+    // scratch of the functions below
+    std::vector<char> tkeep;
+    std::vector<int> tried;
+    std::vector<std::pair<int, int> > diags;
+    std::vector<std::pair<int, int> > bins;
+    std::vector<candidate> voted;
+    std::vector<int> fwd_wave, rev_wave;
+    std::vector<fwd_accessor> fwd_refs;
+    std::vector<rev_accessor> rev_refs;
+    std::vector<fwd_bin_accessor> fwd_segs;
+    std::vector<rev_bin_accessor> rev_segs;
+    std::vector<batch_result> res;
+    std::vector<index_it> block;
+    // hit and alignment of the segment last aligned
+    candidate hit;
+    ref_hit vote;
+} worker;
+
+std::vector<worker> workers;
+// segments of the round, those aligned, and their hits and alignments,
+// applied in this order after all are aligned, see apply_found
+std::vector<index_it> order;
+std::vector<char> aligned;
+std::vector<candidate> found_cands;
+std::vector<ref_hit> found_votes;
+// next segment of order to be taken, and number of segments done
+size_t next_seg = 0;
+int nprocessed = 0;
 
 // max number of iteration round
 int max_round = INT_MAX;
@@ -95,9 +214,6 @@ int max_trial = 32;
 FILE *fpdump = NULL;
 FILE *fpref = NULL;
 
-typedef std::list<int>::iterator list_it;
-typedef std::list<seq_index>::iterator index_it;
-
 inline unsigned get_seq_len(const t_bseq *x) { return *((unsigned *)x); }
 
 /* 
@@ -107,13 +223,12 @@ inline unsigned get_seq_len(const t_bseq *x) { return *((unsigned *)x); }
  * ===========================================================================
  */
     void
-set_active_seg ( seq_index &idx )
+set_active_seg ( worker &w, seq_index &idx )
 {
-    if (idx.id != seg_id) {
-        seg_id = idx.id;
-        seg_bin = buf + idx.offset;
-        seg_len = get_seq_len(seg_bin);
-        dna_seq::bin2text(seg_bin, seg_txt, seg_len+1); 
+    if (idx.id != w.seg_id) {
+        w.seg_id = idx.id;
+        w.seg_bin = buf + idx.offset;
+        w.seg_len = get_seq_len(w.seg_bin);
     }
 }		/* -----  end of function set_active_seg  ----- */
 
@@ -123,8 +238,9 @@ set_active_seg ( seq_index &idx )
  *  Description:  
  * ===========================================================================
  */
+template <class A>
     void
-dump_seq ( FILE *fp, seq_accessor *pac, int length )
+dump_seq ( FILE *fp, A *pac, int length )
 {
     assert(pac->length() >= length);
     for (int i = 0; i < length; ++i) 
@@ -163,12 +279,17 @@ select_ref ( const char *fname )
  *  Description:  parse spaced seed pattern to a mask
  * ===========================================================================
  */
-    unsigned
+    t_seed
 parse_pattern ( const char *pat )
 {
-    char dnapat[MAX_PAT_LEN+1] = "AAAAAAAAAAAAAAAA";
+    char dnapat[MAX_PAT_LEN+1];
     size_t len = std::min(strlen(pat), (size_t)MAX_PAT_LEN);
+    memset(dnapat, 'A', MAX_PAT_LEN);
+    dnapat[MAX_PAT_LEN] = '\0';
 
+    if (strlen(pat) > MAX_PAT_LEN) 
+        LOG("WARNING: pattern is longer than %d, truncated "
+                "(build with SEED_BITS=64 for up to 32)\n", MAX_PAT_LEN);
 #ifdef DBG
     if (len < MAX_PAT_LEN) 
         LOG("WARNING: pattern is shorter than %d\n", MAX_PAT_LEN);
@@ -182,25 +303,28 @@ parse_pattern ( const char *pat )
 /* 
  * ===  FUNCTION  ============================================================
  *         Name:  init
- *  Description:  init pref, paligner, seed, seedmap
+ *  Description:  init pref, seed, seedmap
  * ===========================================================================
  */
     void
-init ( FILE *fp, const char *seed_file, double ratio, bool l )
+init ( FILE *fp, const char *seed_file, bool l )
 {
-    char tmp[MAX_SEQ_LEN];
-
     // init random function with a seed
     srand( (unsigned)time(0) );
 
     // set reference
     if (fp) {     // from file
-        if (fgets(tmp, MAX_SEQ_LEN, fp) == NULL)
+        // a line of any length, the reference growing as needed
+        char *tmp = NULL;
+        size_t n = 0;
+        ssize_t len = getline(&tmp, &n, fp);
+        if (len <= 0)
             handle_error("failed to open ref_file");
         int weight = 1;
         fscanf(fp, "%d", &weight);
         LOG("reference weight: %d\n", weight);
-        pref = new ref_seq(tmp, strlen(tmp), l, weight);
+        pref = new ref_seq(tmp, len, l, weight);
+        free(tmp);
         fclose(fp);
     } else {                        // from random-selected segment
         index_it it = indices.begin();
@@ -211,10 +335,6 @@ init ( FILE *fp, const char *seed_file, double ratio, bool l )
     assert(pref != NULL);
     LOG("ref_len: %d\n", pref->length());
 
-    // instantiate aligner
-    paligner = new t_aligner(ratio);
-    assert(paligner != NULL);
-
     // parse spaced seed
     fp = fopen(seed_file, "r");
     if (fp == NULL) 
@@ -224,7 +344,8 @@ init ( FILE *fp, const char *seed_file, double ratio, bool l )
     while (fgets(ptn_str, 1024, fp) != NULL) {
         ptn_str[strlen(ptn_str)-1] = '\0';  // get rid of new-line 
         seeds.push_back(parse_pattern(ptn_str));
-        LOG("seed %s: %08x\n", ptn_str, seeds.back());
+        LOG("seed %s: %0*llx\n", ptn_str, SEED_BITS/4, 
+                (unsigned long long)seeds.back());
     } 
     fclose(fp);
 }		/* -----  end of function init  ----- */
@@ -251,52 +372,549 @@ filter_seq ( const char *pa, int la, const char *pb, int lb )
     return (diff*4) > (la + lb);
 }		/* -----  end of function filter_seq  ----- */
 
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  try_candidate
+ *  Description:  try align segment seq to reference from seed hit c, with
+ *  the aligner of w, and keep the hit and the alignment in w if aligned,
+ *  to be applied after the round. Return true if aligned. 
+ * ===========================================================================
+ */
+    bool
+try_candidate ( worker &w, t_bseq *seq, const candidate &c )
+{
+#ifdef DBG
+    __sync_fetch_and_add(&_nhits, 1);
+#endif
+    bool ok;
+    if (c.forward) {
+        fwd_bin_accessor ac_seg(seq, c.s_offset, c.s_len);
+        ok = pref->align(w.paligner, c.r_offset, &ac_seg, c.pattern, &w.vote);
+    } else {
+        rev_bin_accessor ac_seg(seq, c.s_offset, c.s_len);
+        ok = pref->align(w.paligner, c.r_offset, &ac_seg, c.pattern, &w.vote);
+    }
+    if (ok) w.hit = c;
+    return ok;
+}		/* -----  end of function try_candidate  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  try_hits
+ *  Description:  try align segment of w to reference from every hit of c's
+ *  pattern, shifted by shift, but those tried for previous patterns, which
+ *  are in tried. tried is extended by the hits tried. Return true if
+ *  aligned. 
+ * ===========================================================================
+ */
+    inline bool
+try_hits ( worker &w, seed_span hits, int shift, candidate c, 
+        std::vector<int> &tried )
+{
+    size_t nprev = tried.size();
+    for (const int *it = hits.begin(); it != hits.end(); ++it) {
+        c.r_offset = (*it)+shift;
+        if (std::find(tried.begin(), tried.begin()+nprev, c.r_offset) 
+                != tried.begin()+nprev) 
+            continue;
+        if (try_candidate(w, w.seg_bin, c)) return true;
+        tried.push_back(c.r_offset);
+    }
+    return false;
+}		/* -----  end of function try_hits  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  probe_kept
+ *  Description:  check if the probe-th seed of get_probes, the tail ones
+ *  from max_trial, is a minimizer of pattern k, or if all seeds are used
+ * ===========================================================================
+ */
+    inline bool
+probe_kept ( worker &w, int k, int probe )
+{
+    return !seedmap.sampled() || w.kept[2*max_trial*k + probe];
+}		/* -----  end of function probe_kept  ----- */
+
 /* 
  * ===  FUNCTION  ============================================================
  *         Name:  try_align
  *  Description:  try align segment to reference from postion at pos in
- *  direction of dir. Return true if aligned. 
+ *  direction of dir, from the hits of its seed sd, the probe-th one, by
+ *  every pattern in turn. A hit found by several patterns is tried once.
+ *  Return true if aligned. 
+ * ===========================================================================
+ */
+    inline bool
+try_align ( worker &w, seq_index &idx, size_t pos, int dir, t_seed sd, 
+        int probe )
+{
+    std::vector<int> &tried = w.tried;
+    tried.clear();
+    for (int k = 0; k < seedmap.npattern(); ++k) {
+        if (!probe_kept(w, k, probe)) continue;
+        seed_span hits = seedmap.find(k, sd);
+        if (hits.empty()) continue;
+
+#ifdef DBG
+        __sync_fetch_and_add(&_ntrials, 1);
+#endif
+
+        set_active_seg(w, idx);
+
+        bool forward = dir == 1;
+        int s_offset = forward ? pos : pos+N_SEQ_WORD-1;
+        int s_len = forward ? w.seg_len - s_offset : s_offset + 1;
+
+        // too short to justify overlap
+        if (s_len < OVERLAP_MIN) return false;       
+
+        // aligned in place in the binary, in a fixed direction
+        candidate c = {0, 0, s_offset, s_len, seedmap.pattern(k), forward};
+        if (try_hits(w, hits, forward ? 0 : N_SEQ_WORD-1, c, tried)) 
+            return true;
+    }
+    return false;
+}		/* -----  end of function try_align  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  tried_before
+ *  Description:  check if cands[from:to] have a hit at r_offset
  * ===========================================================================
  */
     inline bool
-try_align ( seq_index &idx, size_t pos, int dir)
+tried_before ( std::vector<candidate> &cands, size_t from, size_t to, 
+        int r_offset )
 {
+    for (size_t h = from; h < to; ++h)
+        if (cands[h].r_offset == r_offset) return true;
+    return false;
+}		/* -----  end of function tried_before  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  vote_hits
+ *  Description:  replace the seed hits cands[from:] of a segment by one hit
+ *  per diagonal (reference offset minus segment offset) supported by at
+ *  least min_votes of them, most supported first, at most N_VOTED. Hits of
+ *  diagonals at most DIAG_SLACK apart are binned together, and a bin is
+ *  represented by its hit coming first in cands. 
+ * ===========================================================================
+ */
+    void
+vote_hits ( worker &w, std::vector<candidate> &cands, size_t from )
+{
+    std::vector<std::pair<int, int> > &diags = w.diags;    // diagonal, hit
+    std::vector<std::pair<int, int> > &bins = w.bins;      // -votes, hit
+    std::vector<candidate> &voted = w.voted;
+    diags.clear();
+    bins.clear();
+    voted.clear();
+    for (size_t h = from; h < cands.size(); ++h)
+        diags.push_back(std::make_pair(cands[h].r_offset - cands[h].s_offset,
+                    (int)h));
+    std::sort(diags.begin(), diags.end());
+    for (size_t i = 0, e; i < diags.size(); i = e) {
+        int h = diags[i].second;
+        for (e = i+1; e < diags.size() 
+                && diags[e].first - diags[e-1].first <= DIAG_SLACK; ++e)
+            h = std::min(h, diags[e].second);
+        if ((int)(e - i) >= min_votes)
+            bins.push_back(std::make_pair(-(int)(e - i), h));
+    }
+    std::sort(bins.begin(), bins.end());
+    for (size_t b = 0; b < bins.size() && b < N_VOTED; ++b) 
+        voted.push_back(cands[bins[b].second]);
+    cands.resize(from);
+    cands.insert(cands.end(), voted.begin(), voted.end());
+}		/* -----  end of function vote_hits  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  get_probes
+ *  Description:  point head and tail at the seeds of the first max_trial
+ *  windows from both ends of segment idx, in the probe file if mapped,
+ *  rolled otherwise. They are valid until the next call. 
+ * ===========================================================================
+ */
+    void
+get_probes ( worker &w, seq_index &idx, const t_seed **head, 
+        const t_seed **tail )
+{
+    std::vector<t_seed> &probes = w.probes;
+    if (probe_tab) {
+        *head = probe_tab + (size_t)idx.ord * 2 * probe_trials;
+        *tail = *head + probe_trials;
+        return;
+    }
     t_bseq *seq = buf + idx.offset;
-    sm_it sit = seedmap.find(dna_seq::seed_at(seq, pos) & seed);
-    if (sit == seedmap.end()) return false;
+    unsigned slen = get_seq_len(seq);
+    probes.resize(2*max_trial);
+    fwd_bin_seeds(bin_bases(seq), 0).fill(&probes[0], max_trial);
+    rev_bin_seeds(bin_bases(seq), slen-N_SEQ_WORD).fill(&probes[max_trial], max_trial);
+    *head = &probes[0];
+    *tail = &probes[max_trial];
+}		/* -----  end of function get_probes  ----- */
 
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  sample_probes
+ *  Description:  keep the minimizers of every pattern among the seeds head
+ *  and tail of get_probes, as the reference is sampled, see probe_kept
+ * ===========================================================================
+ */
+    void
+sample_probes ( worker &w, const t_seed *head, const t_seed *tail )
+{
+    std::vector<char> &tkeep = w.tkeep, &kept = w.kept;
+    if (!seedmap.sampled()) return;
+    kept.resize(2*max_trial*seedmap.npattern());
+    for (int k = 0; k < seedmap.npattern(); ++k) {
+        sample_minimizers(head, max_trial, seedmap.pattern(k), window, tkeep);
+        std::copy(tkeep.begin(), tkeep.end(), kept.begin() + 2*max_trial*k);
+        sample_minimizers(tail, max_trial, seedmap.pattern(k), window, tkeep);
+        std::copy(tkeep.begin(), tkeep.end(), 
+                kept.begin() + 2*max_trial*k + max_trial);
+    }
+}		/* -----  end of function sample_probes  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  collect_hits
+ *  Description:  append the seed hits of segment idx, the read-th of its
+ *  block, to cands in the order try_align visits them, or only those voted
+ *  by vote_hits if min_votes is set
+ * ===========================================================================
+ */
+    void
+collect_hits ( worker &w, seq_index &idx, int read, 
+        std::vector<candidate> &cands )
+{
+    size_t start = cands.size();
+    unsigned slen = get_seq_len(buf + idx.offset);
+    const t_seed *head, *tail;
+    get_probes(w, idx, &head, &tail);
+    sample_probes(w, head, tail);
+    for (size_t j = 0; j < max_trial; ++j) {
+        for (int dir = 1; dir >= -1; dir -= 2) {
+            size_t pos = dir == 1 ? j : slen-j-N_SEQ_WORD;
+            t_seed sd = dir == 1 ? head[j] : tail[j];
+            size_t from = cands.size();
+            for (int k = 0; k < seedmap.npattern(); ++k) {
+                if (!probe_kept(w, k, dir == 1 ? j : max_trial+j)) continue;
+                seed_span hits = seedmap.find(k, sd);
+                if (hits.empty()) continue;
 #ifdef DBG
-    ++_ntrials;
+                __sync_fetch_and_add(&_ntrials, 1);
 #endif
+                candidate c;
+                c.read = read;
+                c.forward = dir == 1;
+                c.s_offset = c.forward ? pos : pos+N_SEQ_WORD-1;
+                c.s_len = c.forward ? slen - c.s_offset : c.s_offset + 1;
+                c.pattern = seedmap.pattern(k);
+                if (c.s_len < OVERLAP_MIN) break;
+                size_t to = cands.size();
+                for (const int *it = hits.begin(); it != hits.end(); ++it) {
+                    c.r_offset = c.forward ? (*it) : (*it)+N_SEQ_WORD-1;
+                    if (!tried_before(cands, from, to, c.r_offset))
+                        cands.push_back(c);
+                }
+            }
+        }
+    }
+    if (min_votes) vote_hits(w, cands, start);
+}		/* -----  end of function collect_hits  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  try_voted
+ *  Description:  try align segment idx from the seed hits of the diagonals
+ *  voted by all its trials, see vote_hits. Return true if aligned. 
+ * ===========================================================================
+ */
+    bool
+try_voted ( worker &w, seq_index &idx )
+{
+    w.cands.clear();
+    collect_hits(w, idx, 0, w.cands);
+    for (size_t h = 0; h < w.cands.size(); ++h)
+        if (try_candidate(w, buf + idx.offset, w.cands[h])) return true;
+    return false;
+}		/* -----  end of function try_voted  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  filter_hits
+ *  Description:  filter the current hits of the segments of wave, all in
+ *  direction forward, with align_batch, acs_ref and acs_seg being scratch of
+ *  the accessors of the reference and of the segments. A segment whose hit
+ *  passes is done, otherwise its next hit is current. 
+ * ===========================================================================
+ */
+template <class R, class S>
+    void
+filter_hits ( worker &w, std::vector<int> &wave, bool forward, 
+        std::vector<R> &acs_ref, std::vector<S> &acs_seg )
+{
+    std::vector<batch_result> &res = w.res;
+    if (wave.empty()) return;
+    acs_ref.clear();
+    acs_seg.clear();
+    for (size_t v = 0; v < wave.size(); ++v) {
+        candidate &c = w.cands[w.cursor[wave[v]]];
+        seq_accessor ac = pref->get_accessor(c.r_offset, forward);
+        acs_ref.push_back(R(ac.pt(0), forward, ac.length()));
+        acs_seg.push_back(S(buf + w.block[wave[v]]->offset, c.s_offset, 
+                    c.s_len));
+    }
+    res.resize(wave.size());
+    w.paligner->align_batch(&acs_ref[0], &acs_seg[0], wave.size(), &res[0]);
+    for (size_t v = 0; v < wave.size(); ++v) {
+        int k = wave[v];
+        if (res[v].ret >= 0 && res[v].matlen_a >= OVERLAP_MIN) 
+            w.pass[k] = w.cursor[k];
+        else 
+            ++w.cursor[k];
+    }
+}		/* -----  end of function filter_hits  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  keep_found
+ *  Description:  keep the hit and the alignment last found by w as those of
+ *  the i-th segment of order, to be applied by apply_found
+ * ===========================================================================
+ */
+    inline void
+keep_found ( worker &w, size_t i )
+{
+    aligned[i] = 1;
+    found_cands[i] = w.hit;
+    found_votes[i] = w.vote;
+}		/* -----  end of function keep_found  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  align_block
+ *  Description:  align the block of segments of w, those of order from
+ *  from, keep those aligned, and return the number of them. Seed hits of all
+ *  the segments are first filtered in waves by align_batch, the next hit of
+ *  every segment without a hit passing the score-only alignment so far,
+ *  against the reference at the beginning of the block. Then every segment
+ *  is aligned by try_align as usual from its first hit passing the filter.
+ *  Hits long enough to be aligned by chaining seeds pass without filtering.
+ * ===========================================================================
+ */
+    int
+align_block ( worker &w, size_t from )
+{
+    std::vector<index_it> &block = w.block;
+    int n = block.size();
+
+    w.first.resize(n+1);
+    w.cursor.resize(n);
+    w.pass.assign(n, -1);
+    w.cands.clear();
+    for (int k = 0; k < n; ++k) {
+        w.first[k] = w.cursor[k] = w.cands.size();
+        collect_hits(w, *block[k], k, w.cands);
+    }
+    w.first[n] = w.cands.size();
 
-    set_active_seg(idx);
-
-    bool forward = dir == 1;
-    int s_offset = forward ? pos : pos+16-1;
-    int s_len = forward ? seg_len - s_offset : s_offset + 1;
-    seq_accessor ac_seg(seg_txt+s_offset, forward, s_len);
-
-    // too short to justify overlap
-    if (s_len < OVERLAP_MIN) return false;       
-
-    list_it it = sit->second.begin();
-    list_it end = sit->second.end();
-    for (; it != end; ++it) {
-        int r_offset = forward ? (*it) : (*it)+16-1;
-        if (pref->try_align(paligner, r_offset, &ac_seg)) { 
-            if (fpdump) { 
-                seq_accessor ac_ref = pref->get_accessor(r_offset, forward);
-                dump_seq(fpdump, &ac_ref, paligner->matlen_a);
-                ac_seg.reset(0);
-                dump_seq(fpdump, &ac_seg, paligner->matlen_b); 
-                fflush(fpdump);
+    for (;;) {
+        w.fwd_wave.clear();
+        w.rev_wave.clear();
+        for (int k = 0; k < n; ++k) {
+            if (w.pass[k] >= 0 || w.cursor[k] == w.first[k+1]) continue;
+            candidate &c = w.cands[w.cursor[k]];
+            if (c.s_len >= CHAIN_MIN_LEN) 
+                w.pass[k] = w.cursor[k];
+            else 
+                (c.forward ? w.fwd_wave : w.rev_wave).push_back(k);
+        }
+        if (w.fwd_wave.empty() && w.rev_wave.empty()) break;
+        filter_hits(w, w.fwd_wave, true, w.fwd_refs, w.fwd_segs);
+        filter_hits(w, w.rev_wave, false, w.rev_refs, w.rev_segs);
+    }
+
+    int nfound = 0;
+    for (int k = 0; k < n; ++k) {
+        for (int h = w.pass[k]; h >= 0 && h < w.first[k+1]; ++h) {
+            if (try_candidate(w, buf + block[k]->offset, w.cands[h])) {
+                keep_found(w, from+k);
+                ++nfound;
+                break;
             }
-            return true;
         }
     }
+    return nfound;
+}		/* -----  end of function align_block  ----- */
 
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  align_segment
+ *  Description:  align segment idx from the seeds at both ends, or from
+ *  the diagonals they vote if min_votes is set. Return true if aligned. 
+ * ===========================================================================
+ */
+    bool
+align_segment ( worker &w, seq_index &idx )
+{
+    if (min_votes) return try_voted(w, idx);
+    unsigned slen = get_seq_len(buf + idx.offset);
+    const t_seed *head, *tail;
+    get_probes(w, idx, &head, &tail);
+    sample_probes(w, head, tail);
+    // number of trial 
+    for (size_t j = 0; j < max_trial; ++j) {
+        // try both forward and backward
+        if (try_align(w, idx, j, 1, head[j], j) 
+                || try_align(w, idx, slen-j-N_SEQ_WORD, -1, tail[j], 
+                    max_trial+j))
+            return true;
+    }
     return false;
-}		/* -----  end of function try_align  ----- */
+}		/* -----  end of function align_segment  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  align_segments
+ *  Description:  thread of worker arg, align the segments of order taken a
+ *  block or SEG_CHUNK at a time, until none is left, and keep those
+ *  aligned. The reference is not changed meanwhile. 
+ * ===========================================================================
+ */
+    void*
+align_segments ( void *arg )
+{
+    worker &w = *(worker*)arg;
+    size_t chunk = batch_reads > 0 ? batch_reads : SEG_CHUNK;
+    for (;;) {
+        size_t from = __sync_fetch_and_add(&next_seg, chunk);
+        if (from >= order.size()) break;
+        size_t to = std::min(from + chunk, order.size());
+        if (batch_reads > 0) {
+            w.block.assign(order.begin() + from, order.begin() + to);
+            align_block(w, from);
+        }
+        for (size_t i = from; i < to; ++i) {
+            if (batch_reads <= 0 && align_segment(w, *order[i]))
+                keep_found(w, i);
+            int count = __sync_add_and_fetch(&nprocessed, 1);
+            if (!(count & 0xFFFF)) LOG("%d sequences processed\n", count);
+        }
+    }
+    return NULL;
+}		/* -----  end of function align_segments  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  apply_found
+ *  Description:  apply the alignment kept for the i-th segment of order to
+ *  the reference, pac_seg being the segment from its hit, with the aligner
+ *  of w, and dump them if applied. Return true if applied. 
+ * ===========================================================================
+ */
+template <class A>
+    inline bool
+apply_found ( worker &w, size_t i, A *pac_seg )
+{
+    ref_hit &hit = found_votes[i];
+    if (!pref->apply(w.paligner, hit, pac_seg, found_cands[i].pattern)) 
+        return false;
+#ifdef DBG
+    LOG("found %d at cost %d:\tref_ml=%d,\tseg_ml=%d\n",
+            order[i]->id, hit.cost, hit.matlen_a, hit.matlen_b);
+#endif
+    if (fpdump) { 
+        seq_accessor ac_ref = pref->get_accessor(hit.pos, hit.forward);
+        dump_seq(fpdump, &ac_ref, hit.matlen_a);
+        pac_seg->reset(0);
+        dump_seq(fpdump, pac_seg, hit.matlen_b); 
+        fflush(fpdump);
+    }
+    return true;
+}		/* -----  end of function apply_found  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  apply_found
+ *  Description:  apply the alignment kept for the i-th segment of order,
+ *  see above 
+ * ===========================================================================
+ */
+    bool
+apply_found ( worker &w, size_t i )
+{
+    const candidate &c = found_cands[i];
+    t_bseq *seq = buf + order[i]->offset;
+    if (c.forward) {
+        fwd_bin_accessor ac_seg(seq, c.s_offset, c.s_len);
+        return apply_found(w, i, &ac_seg);
+    }
+    rev_bin_accessor ac_seg(seq, c.s_offset, c.s_len);
+    return apply_found(w, i, &ac_seg);
+}		/* -----  end of function apply_found  ----- */
+
+/* 
+ * ===  FUNCTION  ============================================================
+ *         Name:  self_check
+ *  Description:  align every pair of sequences in fname, in both directions,
+ *  with every engine supported by the CPU and compare them with the scalar
+ *  reference. SIMD engines must reproduce it exactly, and the bit-parallel
+ *  one must succeed whenever it does, at no higher cost. Return the number of
+ *  mismatches. 
+ * ===========================================================================
+ */
+    int
+self_check ( const char *fname )
+{
+    std::ifstream fin(fname);
+    std::string ref_str, seg_str;
+    t_aligner *pscalar = new t_aligner(MAXR, ENGINE_SCALAR);
+    t_aligner *pother = new t_aligner(MAXR, ENGINE_BITVEC);
+    int npair = 0, nfail = 0;
+    while (fin >> ref_str >> seg_str) {
+        for (int dir = 0; dir < 2; ++dir) {
+            bool forward = dir == 0;
+            char *pr = (char*)ref_str.c_str() + (forward ? 0 : ref_str.length()-1);
+            char *ps = (char*)seg_str.c_str() + (forward ? 0 : seg_str.length()-1);
+            seq_accessor ac_ref(pr, forward, ref_str.length());
+            seq_accessor ac_seg(ps, forward, seg_str.length());
+            int ml = pscalar->align(&ac_seg, &ac_ref);
+            for (int e = ENGINE_BITVEC; e <= ENGINE_AVX512; ++e) {
+                if (!simd_engine::supported((ENGINE)e)) continue;
+                pother->engine = (ENGINE)e;
+                int ml2 = pother->align(&ac_seg, &ac_ref);
+                bool ok;
+                if (e == ENGINE_BITVEC) {
+                    ok = ml < 0 || (ml2 >= 0 
+                            && pother->final_cost() <= pscalar->final_cost());
+                } else {
+                    ok = ml == ml2 && (ml < 0 
+                            || (pother->final_cost() == pscalar->final_cost()
+                                && pother->nedit == pscalar->nedit));
+                    for (int i = 0; ok && ml >= 0 && i < pscalar->nedit; ++i) {
+                        ok = pother->edits[i].op == pscalar->edits[i].op
+                            && (pscalar->edits[i].op == DELETE 
+                                    || pother->edits[i].val == pscalar->edits[i].val);
+                    }
+                }
+                LOG("pair %d %s %s: %d/%d %s\n", npair, 
+                        forward ? "forward" : "backward", engine_name((ENGINE)e), 
+                        ml2, ml, ok ? "ok" : "MISMATCH");
+                if (!ok) ++nfail;
+            }
+        }
+        ++npair;
+    }
+    delete pscalar;
+    delete pother;
+    LOG("%d pairs checked, %d mismatches\n", npair, nfail);
+    return nfail;
+}		/* -----  end of function self_check  ----- */
 
 /* 
  * ===  FUNCTION  ============================================================
@@ -328,11 +946,13 @@ open_binary ( const char *fname, std::list<seq_index> &indices )
         handle_error("close");
 
     int i = 0;
-    for (size_t offset = 0; offset < len; ) {
+    nsegs = 0;
+    buf_len = len;
+    for (size_t offset = 0; offset < len; ++nsegs) {
         size_t seq_len = *((unsigned*)(buf + offset));
-        // make sure segments in indices are not too short or too long
-        if (seq_len > SEQ_THRESHOLD && seq_len < MAX_READ_LEN) { 
-            indices.push_back(seq_index(i++, offset));
+        // make sure segments in indices are not too short, and fit reference
+        if (seq_len > SEQ_THRESHOLD && seq_len < MAX_SEQ_LEN) { 
+            indices.push_back(seq_index(i++, offset, nsegs));
         }
         if (seq_len > max_len) {
             max_len = seq_len;
@@ -357,14 +977,16 @@ main ( int argc, char *argv[] )
     int opt;
     double ratio = MAXR;
     bool locked = false;
+    bool batch = false;
     char ref_file[PATH_MAX] = {0};
+    const char *probe_file = NULL;
 
     if (argc < 3) {
         fprintf(stderr, usage_str, argv[0]);
         return EXIT_FAILURE;
     }
 
-    while ((opt = getopt(argc, argv, "f:r:d:m:t:lh")) != -1) {
+    while ((opt = getopt(argc, argv, "f:r:d:m:t:A:x:b:M:v:P:w:j:s:olBh")) != -1) {
         switch (opt) {
             case 'h':
                 fprintf(stdout, usage_str, argv[0]);
@@ -383,12 +1005,47 @@ main ( int argc, char *argv[] )
             case 'l':
                 locked = true;
                 break;
+            case 'B':
+                batch = true;
+                break;
             case 'm':
                 max_round = atoi(optarg);
                 break;
             case 't':
                 max_trial = atoi(optarg);
                 break;
+            case 'A':
+                if ((engine = (ENGINE)engine_by_name(optarg)) == 0) {
+                    fprintf(stderr, usage_str, argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'x':
+                xdrop = atoi(optarg);
+                break;
+            case 'b':
+                batch_reads = atoi(optarg);
+                break;
+            case 'o':
+                one_pattern = true;
+                break;
+            case 'M':
+                max_occ = atoi(optarg);
+                break;
+            case 'v':
+                min_votes = atoi(optarg);
+                break;
+            case 'P':
+                probe_file = optarg;
+                break;
+            case 'w':
+                window = atoi(optarg);
+                break;
+            case 'j':
+                nthreads = std::max(1, atoi(optarg));
+                break;
+            case 's':
+                return self_check(optarg) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
             default: /*  '?' */
                 fprintf(stderr, usage_str, argv[0]);
                 exit(EXIT_FAILURE);
@@ -399,52 +1056,90 @@ main ( int argc, char *argv[] )
     i_max_len = open_binary(argv[optind], indices);
     LOG("indices: size %d\n", indices.size());
     LOG("number of seeding trial: %d\n", max_trial);
+    if (probe_file) {
+        const seed_file_header *h = seed_file_map(probe_file, SEED_FILE_PROBES);
+        if (h == NULL) return EXIT_FAILURE;
+        if (h->param[1] != (unsigned long long)nsegs 
+                || h->param[2] != buf_len || h->param[0] < (unsigned long long)max_trial) {
+            fprintf(stderr, "%s: not the probes of %s for %d trials\n", 
+                    probe_file, argv[optind], max_trial);
+            return EXIT_FAILURE;
+        }
+        probe_tab = (const t_seed*)seed_file_section(h, 0);
+        probe_trials = h->param[0];
+    }
 //    LOG("i_max_len: %d\n", i_max_len);
 
     // set the best DNA sequence as initial reference
 //    int iref = select_ref("src/quality.in");
     // pick up a random segment as the starting reference
-    init(fpref, argv[optind+1], ratio, locked);
+    init(fpref, argv[optind+1], locked);
+    pref->batch_votes(batch);
+
+    // an aligner and the information of its active segment per thread
+    workers.resize(nthreads);
+    for (int t = 0; t < nthreads; ++t) {
+        workers[t].paligner = new t_aligner(ratio, engine);
+        workers[t].paligner->xdrop = xdrop;
+        workers[t].seg_id = -1;
+    }
+    LOG("engine: %s, xdrop: %d, threads: %d\n", 
+            engine_name(workers[0].paligner->engine), xdrop, nthreads);
 
     int nfailure = 0;
+    seedmap.set_max_occ(max_occ);
+    seedmap.set_window(window);
+    if (!one_pattern) seedmap.set_patterns(seeds);
     for (int nround = 1; nround <= max_round; ++nround) { 
-        // pick up a random seed if there is no failure
-        seed = nfailure == 0 ? seeds[rand() % seeds.size()] : seeds[nfailure-1];
         LOG("--------------- round %d ---------\n", nround);
-        LOG("seed: %08x\n", seed);
-        LOG("seedmap size: %d\n", pref->get_seedmap(seedmap, seed));
+        if (one_pattern) {
+            // pick up a random seed if there is no failure
+            seed = nfailure == 0 ? seeds[rand() % seeds.size()] 
+                : seeds[nfailure-1];
+            seedmap.set_patterns(std::vector<t_seed>(1, seed));
+            LOG("seed: %0*llx\n", SEED_BITS/4, (unsigned long long)seed);
+        }
+        LOG("seedmap size: %d\n", pref->get_seedmap(seedmap));
+        if (max_occ) 
+            LOG("seeds masked: %lu\n", (unsigned long)seedmap.nmasked());
+        if (seedmap.sampled())
+            LOG("minimizers indexed: %lu\n", (unsigned long)seedmap.npos());
         LOG("reference length: %d\n", pref->length());
+        order.clear();
+        for (index_it it = indices.begin(); it != indices.end(); ++it)
+            order.push_back(it);
+        aligned.assign(order.size(), 0);
+        found_cands.resize(order.size());
+        found_votes.resize(order.size());
+        next_seg = 0;
+        nprocessed = 0;
+        if (nthreads > 1) {
+            std::vector<pthread_t> threads(nthreads);
+            for (int t = 0; t < nthreads; ++t)
+                if (pthread_create(&threads[t], NULL, align_segments, 
+                            &workers[t]) != 0)
+                    handle_error("pthread_create");
+            for (int t = 0; t < nthreads; ++t)
+                pthread_join(threads[t], NULL);
+        } else {
+            align_segments(&workers[0]);
+        }
+        // apply in the order of the segments, whatever thread found them
         int nmatches = 0;
-        int count = 0;
-        index_it it = indices.begin();
-        while (it != indices.end()) {
-            bool found = 0;
-            unsigned slen = get_seq_len(buf + it->offset);
-            // number of trial 
-            for (size_t j = 0; j < max_trial; ++j) {
-                // try both forward and backward
-                if (try_align(*it, j, 1) || try_align(*it, slen-j-16, -1)) {
-                    found = 1;
-#ifdef DBG
-                    LOG("found %d at cost %d:\tref_ml=%d,\tseg_ml=%d\n",
-                            it->id, paligner->final_cost(), 
-                            paligner->matlen_a, paligner->matlen_b);
-#endif
-                    ++nmatches;
-                    break;
-                }
-            }
-            it = found ? indices.erase(it) : ++it;
-            if (!(++count & 0xFFFF)) LOG("%d sequences processed\n", count);
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (!aligned[i] || !apply_found(workers[0], i)) continue;
+            indices.erase(order[i]);
+            ++nmatches;
         }
 #ifdef DBG
         LOG("#trials: %d\n", _ntrials);
+        LOG("#hits aligned: %lu\n", (unsigned long)_nhits);
         LOG("#matches: %d\n", nmatches);
 #endif
         if (nmatches != 0) 
             nfailure = 0;   // reset only if we have find some match
-        else if (++nfailure == seeds.size())    // stop if all seeds tried
-            break;
+        else if (!one_pattern || ++nfailure == seeds.size())
+            break;          // stop if all seeds tried
 
         pref->evolve();
         // print out consensus
@@ -39,6 +39,26 @@ protected:
             } 
         }
     };
+    // check the edits transform seg_a[0:matlen_a] to seg_b[0:matlen_b]
+    void path_tester(seq_accessor *pa, seq_accessor *pb, t_aligner *paligner) {
+        int i = 0, j = 0, cost = 0;
+        for (int k = 0; k < paligner->nedit; ++k) {
+            char op = paligner->edits[k].op;
+            if (op == MATCH) {
+                EXPECT_EQ(pb->at(j), paligner->edits[k].val);
+                cost += pa->at(i++) != pb->at(j++);
+            } else if (op == INSERT) {
+                EXPECT_EQ(pb->at(j++), paligner->edits[k].val);
+                ++cost;
+            } else {
+                ++i;
+                ++cost;
+            }
+        }
+        EXPECT_EQ(paligner->matlen_a, i);
+        EXPECT_EQ(paligner->matlen_b, j);
+        EXPECT_EQ(paligner->final_cost(), cost);
+    };
 };
 
 TEST_F(aligner_test, forward) {
@@ -116,3 +136,231 @@ TEST_F(aligner_test, sample) {
     EXPECT_EQ(-1, paligner->align(&seg2, &ref2));
 }
 
+
+TEST_F(aligner_test, engines) {
+    t_aligner *pscalar = new t_aligner(MAXR, ENGINE_SCALAR);
+    t_aligner *pother = new t_aligner(MAXR, ENGINE_BITVEC);
+    std::ifstream fin("test/real_align.txt");
+    std::string ref_str, seg_str;
+    int npair = 0;
+    while (fin >> ref_str >> seg_str) {
+        for (int dir = 0; dir < 2; ++dir) {
+            bool fwd = dir == 0;
+            seq_accessor ref((char*)ref_str.c_str() 
+                    + (fwd ? 0 : ref_str.length()-1), fwd, ref_str.length());
+            seq_accessor seg((char*)seg_str.c_str() 
+                    + (fwd ? 0 : seg_str.length()-1), fwd, seg_str.length());
+            int rs = pscalar->align(&seg, &ref);
+            for (int e = ENGINE_BITVEC; e <= ENGINE_AVX512; ++e) {
+                if (!simd_engine::supported((ENGINE)e)) continue;
+                pother->engine = (ENGINE)e;
+                int ro = pother->align(&seg, &ref);
+                if (e == ENGINE_BITVEC) {
+                    // wider band, never worse than scalar
+                    if (rs > 0) {
+                        EXPECT_LT(0, ro);
+                        EXPECT_GE(pscalar->final_cost(), pother->final_cost());
+                    }
+                } else {
+                    // same cells, same path
+                    EXPECT_EQ(rs, ro);
+                    if (rs > 0) {
+                        EXPECT_EQ(pscalar->final_cost(), pother->final_cost());
+                        ASSERT_EQ(pscalar->nedit, pother->nedit);
+                        for (int i = 0; i < pscalar->nedit; ++i) 
+                            EXPECT_EQ(pscalar->edits[i].op, pother->edits[i].op);
+                    }
+                }
+                if (ro > 0) path_tester(&seg, &ref, pother);
+            }
+        }
+        ++npair;
+    }
+    EXPECT_LT(0, npair);
+    delete pscalar;
+    delete pother;
+}
+
+TEST_F(aligner_test, score_only) {
+    t_aligner *paligner = new t_aligner(MAXR, ENGINE_SCALAR);
+    std::ifstream fin("test/real_align.txt");
+    std::string ref_str, seg_str;
+    while (fin >> ref_str >> seg_str) {
+        seq_accessor ref((char*)ref_str.c_str(), true, ref_str.length());
+        seq_accessor seg((char*)seg_str.c_str(), true, seg_str.length());
+        for (int e = ENGINE_SCALAR; e <= ENGINE_AVX512; ++e) {
+            if (!simd_engine::supported((ENGINE)e)) continue;
+            paligner->engine = (ENGINE)e;
+            int rf = paligner->align(&seg, &ref);
+            int ma = paligner->matlen_a, cost = rf > 0 ? paligner->final_cost() : 0;
+            EXPECT_EQ(rf, paligner->align_score(&seg, &ref));
+            EXPECT_EQ(0, paligner->nedit);
+            if (rf > 0) {
+                EXPECT_EQ(ma, paligner->matlen_a);
+                EXPECT_EQ(cost, paligner->final_cost());
+            }
+        }
+    }
+    delete paligner;
+}
+
+TEST_F(aligner_test, xdrop) {
+    t_aligner *pfull = new t_aligner(MAXR, ENGINE_SCALAR);
+    t_aligner *padapt = new t_aligner(MAXR, ENGINE_SCALAR);
+    padapt->xdrop = 32;
+    std::ifstream fin("test/real_align.txt");
+    std::string ref_str, seg_str;
+    while (fin >> ref_str >> seg_str) {
+        seq_accessor ref((char*)ref_str.c_str(), true, ref_str.length());
+        seq_accessor seg((char*)seg_str.c_str(), true, seg_str.length());
+        for (int e = ENGINE_SCALAR; e <= ENGINE_BITVEC; ++e) {
+            pfull->engine = padapt->engine = (ENGINE)e;
+            int rf = pfull->align(&seg, &ref);
+            int ra = padapt->align(&seg, &ref);
+            // the adaptive band only gives up on the best cell of a row
+            if (rf > 0) {
+                EXPECT_LT(0, ra);
+                EXPECT_LE(pfull->final_cost(), padapt->final_cost());
+                EXPECT_GT(pfull->ncell, 2*padapt->ncell);
+            }
+            if (ra > 0) {
+                path_tester(&seg, &ref, padapt);
+                int cost = padapt->final_cost();
+                EXPECT_EQ(ra, padapt->align_score(&seg, &ref));
+                EXPECT_EQ(cost, padapt->final_cost());
+            }
+        }
+    }
+    delete pfull;
+    delete padapt;
+}
+
+TEST_F(aligner_test, chained) {
+    // 10 kb with ~12% errors, aligned piecewise between seed hits
+    std::string ref_str, seg_str;
+    srand(7);
+    for (int i = 0; i < 10000; ++i) {
+        char c = codes[rand() & 0x3];
+        int r = rand() % 100;
+        ref_str += c;
+        if (r < 4) continue;
+        if (r < 8) seg_str += codes[rand() & 0x3];
+        seg_str += r >= 8 && r < 12 ? codes[(C2I(c)+1) & 0x3] : c;
+    }
+    t_seed sd_pat = dna_seq::encode("TTTAATTTATTATTTT");
+    t_aligner *pchain = new t_aligner();
+    t_aligner *pplain = new t_aligner();
+    for (int dir = 0; dir < 2; ++dir) {
+        bool fwd = dir == 0;
+        seq_accessor ref((char*)ref_str.c_str() 
+                + (fwd ? 0 : ref_str.length()-1), fwd, ref_str.length());
+        seq_accessor seg((char*)seg_str.c_str() 
+                + (fwd ? 0 : seg_str.length()-1), fwd, seg_str.length());
+        EXPECT_LT(0, pchain->align_chained(&seg, &ref, sd_pat));
+        EXPECT_LT(100, pchain->nanchor);
+        EXPECT_LT(seg_str.length() * 0.99, pchain->matlen_a);
+        path_tester(&seg, &ref, pchain);
+        // close to the best path in the band
+        if (pplain->align(&seg, &ref) > 0) 
+            EXPECT_GE(pplain->final_cost() * 1.02, pchain->final_cost());
+    }
+    delete pchain;
+    delete pplain;
+}
+
+TEST_F(aligner_test, long_segment) {
+    // 40 kb, longer than MAX_READ_LEN, with an edit every 16 bases
+    std::string ref_str, seg_str;
+    srand(549);
+    for (int i = 0; i < 40000; ++i) {
+        char c = codes[rand() & 0x3];
+        ref_str += c;
+        if (i % 16 == 0) continue;
+        seg_str += (i % 16 == 5) ? codes[(C2I(c)+1) & 0x3] : c;
+    }
+    t_aligner *plong = new t_aligner();
+    seq_accessor ref((char*)ref_str.c_str(), true, ref_str.length());
+    seq_accessor seg((char*)seg_str.c_str(), true, seg_str.length());
+    EXPECT_LT(0, plong->align(&seg, &ref));
+    EXPECT_GE(5000, plong->final_cost());
+    path_tester(&seg, &ref, plong);
+
+    // a new aligner on this thread reuses the grown workspace
+    edit *pedits = plong->edits;
+    delete plong;
+    plong = new t_aligner();
+    seq_accessor ref2(dna_ref, true, 10);
+    seq_accessor seg2(dna_ref+1, true, 9);
+    EXPECT_EQ(10, plong->align(&seg2, &ref2));
+    EXPECT_EQ(pedits, plong->edits);
+    delete plong;
+}
+
+TEST_F(aligner_test, batch) {
+    t_aligner *pscalar = new t_aligner(MAXR, ENGINE_SCALAR);
+    t_aligner *pbatch = new t_aligner(MAXR, ENGINE_SCALAR);
+    std::ifstream fin("test/real_align.txt");
+    std::vector<std::string> refs, segs;
+    std::string ref_str, seg_str;
+    while (fin >> ref_str >> seg_str) {
+        refs.push_back(ref_str);
+        segs.push_back(seg_str);
+        // a mismatched pair, which fails early
+        refs.push_back(ref_str);
+        segs.push_back(std::string(seg_str.rbegin(), seg_str.rend()));
+    }
+    std::vector<seq_accessor> ref, seg;
+    for (size_t k = 0; k < refs.size(); ++k) {
+        for (int dir = 0; dir < 2; ++dir) {
+            char *pr = (char*)refs[k].c_str() + (dir ? refs[k].length()-1 : 0);
+            char *ps = (char*)segs[k].c_str() + (dir ? segs[k].length()-1 : 0);
+            ref.push_back(seq_accessor(pr, !dir, refs[k].length()));
+            seg.push_back(seq_accessor(ps, !dir, segs[k].length()));
+        }
+    }
+    std::vector<batch_result> res(seg.size());
+    for (int e = ENGINE_SSE; e <= ENGINE_AVX512; ++e) {
+        if (!simd_engine::supported((ENGINE)e)) continue;
+        pbatch->engine = (ENGINE)e;
+        int n = pbatch->align_batch(&seg[0], &ref[0], seg.size(), &res[0]);
+        int naligned = 0;
+        for (size_t k = 0; k < seg.size(); ++k) {
+            int rf = pscalar->align_score(&seg[k], &ref[k]);
+            EXPECT_EQ(rf, res[k].ret);
+            if (rf < 0) continue;
+            ++naligned;
+            EXPECT_EQ(pscalar->matlen_a, res[k].matlen_a);
+            EXPECT_EQ(pscalar->matlen_b, res[k].matlen_b);
+            EXPECT_EQ(pscalar->final_cost(), res[k].cost);
+        }
+        EXPECT_EQ(naligned, n);
+    }
+    delete pscalar;
+    delete pbatch;
+}
+
+TEST_F(aligner_test, typed_accessor) {
+    t_aligner *paligner = new t_aligner(MAXR, ENGINE_SCALAR);
+    std::ifstream fin("test/real_align.txt");
+    std::string ref_str, seg_str;
+    while (fin >> ref_str >> seg_str) {
+        char *pr = (char*)ref_str.c_str() + ref_str.length()-1;
+        char *ps = (char*)seg_str.c_str() + seg_str.length()-1;
+        seq_accessor ref(pr, false, ref_str.length());
+        seq_accessor seg(ps, false, seg_str.length());
+        rev_accessor rref(pr, false, ref_str.length());
+        rev_accessor rseg(ps, false, seg_str.length());
+        int ml = paligner->align(&seg, &ref);
+        int cost = ml > 0 ? paligner->final_cost() : 0;
+        std::vector<edit> edits(paligner->edits, paligner->edits + paligner->nedit);
+        EXPECT_EQ(ml, paligner->align(&rseg, &rref));
+        if (ml <= 0) continue;
+        EXPECT_EQ(cost, paligner->final_cost());
+        ASSERT_EQ((int)edits.size(), paligner->nedit);
+        for (int i = 0; i < paligner->nedit; ++i) {
+            EXPECT_EQ(edits[i].op, paligner->edits[i].op);
+            EXPECT_EQ(edits[i].val, paligner->edits[i].val);
+        }
+    }
+    delete paligner;
+}
@@ -5,7 +5,7 @@
  *         Author:  Ming Chen, brianchenming@gmail.com
  *        Created:  11/26/2011 07:34:54 PM
  *
- *    Description:  test dna_seq and seq_accessor
+ *    Description:  test dna_seq, seed_iterator, seq_accessor and seed_index
  *
  *       Revision:  none
  *
@@ -14,6 +14,7 @@
 
 #include <gtest/gtest.h>
 #include <dna_seq.h>
+#include <seed_index.h>
 
 char dna_str[] = "ACGTGTCATCGGATCAACCGGTT";
 
@@ -29,6 +30,28 @@ TEST(dna_seq, binary) {
     EXPECT_EQ(0xAF058D36, dna_seq::seed_at(bin_buf, 7));
 }
 
+TEST(dna_seq, seed_iterator) {
+    unsigned char bin_buf[10+4];
+    t_seed seeds[8];
+    dna_seq::text2bin(dna_str, bin_buf, 14);
+    EXPECT_EQ(8, dna_seq::seeds(bin_buf, seeds));
+    fwd_txt_seeds ft(txt_bases(dna_str), 0);
+    rev_txt_seeds rt(txt_bases(dna_str), 7);
+    rev_bin_seeds rb(bin_bases(bin_buf), 7);
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_EQ(dna_seq::seed_at(bin_buf, i), seeds[i]);
+        EXPECT_EQ(dna_seq::encode(dna_str+i), ft.next());
+        EXPECT_EQ(dna_seq::encode(dna_str+7-i), rt.next());
+        EXPECT_EQ(dna_seq::seed_at(bin_buf, 7-i), rb.next());
+    }
+    EXPECT_EQ(8, ft.pos());
+    EXPECT_EQ(-1, rb.pos());
+    for (int c = -128; c < 128; ++c) {
+        char ch = c;
+        EXPECT_EQ((unsigned)C2I(ch), txt_bases(&ch).code(0));
+    }
+}
+
 TEST(seq_accessor, forward) {
     seq_accessor da((char *)dna_str, true, 4);
     EXPECT_EQ(4, da.length());
@@ -58,3 +81,214 @@ TEST(seq_accessor, backward) {
     EXPECT_EQ('G', da.next());
     EXPECT_EQ(false, da.has_more());
 }
+
+TEST(seq_accessor, binary) {
+    unsigned char bin_buf[10+4];
+    dna_seq::text2bin(dna_str, bin_buf, 14);
+    int len = strlen(dna_str);
+    for (int pos = 0; pos < len; ++pos) {
+        seq_accessor fa((char *)dna_str + pos, true, len - pos);
+        fwd_bin_accessor fb(bin_buf, pos, len - pos);
+        for (int i = 0; i < len - pos; ++i) 
+            EXPECT_EQ(fa.at(i), fb.at(i));
+        seq_accessor ra((char *)dna_str + pos, false, pos + 1);
+        rev_bin_accessor rb(bin_buf, pos, pos + 1);
+        while (ra.has_more()) 
+            EXPECT_EQ(ra.next(), rb.next());
+        EXPECT_EQ(false, rb.has_more());
+    }
+    rev_bin_accessor sb = rev_bin_accessor(bin_buf, 9, 10).sub(2, 3);
+    EXPECT_EQ(dna_str[7], sb.at(0));
+    EXPECT_EQ(dna_str[5], sb.at(2));
+}
+
+TEST(seed_index, basic) {
+    seed_index idx;
+    t_seed sds[] = {0x12340001, 0x00000005, 0x12340001, 0x12330001, 
+        0xFFFFFFFF, 0x12340000, 0x00000005, 0x12340001};
+    for (int i = 0; i < 8; ++i) idx.add(sds[i], i);
+    idx.build();
+    EXPECT_EQ(5, idx.size());
+    EXPECT_EQ(8, idx.npos());
+    seed_span sp = idx.find(0x12340001);
+    ASSERT_EQ(3, sp.size());
+    EXPECT_EQ(0, sp.begin()[0]);
+    EXPECT_EQ(2, sp.begin()[1]);
+    EXPECT_EQ(7, sp.begin()[2]);
+    EXPECT_EQ(2, idx.find(0x00000005).size());
+    EXPECT_EQ(4, *idx.find(0xFFFFFFFF).begin());
+    EXPECT_EQ(true, idx.find(0x12340002).empty());
+    EXPECT_EQ(true, idx.find(0).empty());
+    idx.clear();
+    idx.build();
+    EXPECT_EQ(0, idx.size());
+    EXPECT_EQ(true, idx.find(0x12340001).empty());
+}
+
+TEST(seed_index, direct) {
+    t_seed mask = 0xFC3CF0FF;
+    seed_index hashed, direct;
+    direct.set_mask(mask);
+    EXPECT_EQ(true, direct.is_direct());
+    unsigned x = 1;
+    for (int i = 0; i < 5000; ++i) {
+        x = x * 1103515245 + 12345;
+        t_seed sd = (x >> 8) & mask & 0x3C30F03F;
+        hashed.add(sd, i);
+        direct.add(sd, i);
+    }
+    hashed.build();
+    direct.build();
+    EXPECT_EQ(hashed.size(), direct.size());
+    for (int soft = 0; soft < 2; ++soft) {
+        direct.pext = direct.pext && !soft;
+        x = 1;
+        for (int i = 0; i < 5000; ++i) {
+            x = x * 1103515245 + 12345;
+            t_seed sd = (x >> 8) & mask & 0x3C30F03F;
+            seed_span a = hashed.find(sd), b = direct.find(sd);
+            ASSERT_EQ(a.size(), b.size());
+            for (size_t k = 0; k < a.size(); ++k)
+                EXPECT_EQ(a.begin()[k], b.begin()[k]);
+        }
+    }
+    EXPECT_EQ(0x3FFFFF, direct.compact(mask));
+    EXPECT_EQ(0x3, direct.compact(0x3));
+    EXPECT_EQ(0x300000, direct.compact(0xC0000000));
+    EXPECT_EQ(true, direct.find(0x100).empty());
+}
+
+TEST(seed_index, multi) {
+    std::vector<t_seed> pats;
+    pats.push_back(0xFF3C3FFC);
+    pats.push_back(0xFFF0CCFC);
+    multi_seed_index multi;
+    multi.set_patterns(pats);
+    seed_index single[2];
+    unsigned x = 1;
+    for (int i = 0; i < 3000; ++i) {
+        x = x * 1103515245 + 12345;
+        multi.add(x & 0x0F0F0F0F, i);
+        for (int k = 0; k < 2; ++k) 
+            if (x & 0x0F0F0F0F & pats[k])
+                single[k].add(x & 0x0F0F0F0F & pats[k], i);
+    }
+    multi.build();
+    single[0].build();
+    single[1].build();
+    EXPECT_EQ(2, multi.npattern());
+    EXPECT_EQ(single[0].size() + single[1].size(), multi.size());
+    x = 1;
+    for (int i = 0; i < 3000; ++i) {
+        x = x * 1103515245 + 12345;
+        for (int k = 0; k < 2; ++k) {
+            seed_span a = single[k].find(x & 0x0F0F0F0F & pats[k]);
+            seed_span b = multi.find(k, x & 0x0F0F0F0F);
+            ASSERT_EQ(a.size(), b.size());
+            if (!a.empty()) EXPECT_EQ(*a.begin(), *b.begin());
+        }
+    }
+}
+
+TEST(seed_index, max_occ) {
+    seed_index idx[2];
+    idx[1].set_mask(0xFF);
+    for (int d = 0; d < 2; ++d) {
+        for (int i = 0; i < 10; ++i) idx[d].add(0x11, i);
+        idx[d].add(0x22, 10);
+        idx[d].add(0x22, 11);
+        idx[d].max_occ = 5;
+        idx[d].build();
+        EXPECT_EQ(true, idx[d].find(0x11).empty());
+        EXPECT_EQ(2, idx[d].find(0x22).size());
+        EXPECT_EQ(2, idx[d].size());
+        EXPECT_EQ(1, idx[d].nmasked());
+        idx[d].max_occ = 0;
+        EXPECT_EQ(10, idx[d].find(0x11).size());
+        EXPECT_EQ(0, idx[d].nmasked());
+    }
+    std::vector<t_seed> pats(1, 0xFF);
+    multi_seed_index multi;
+    multi.set_max_occ(1);
+    multi.set_patterns(pats);
+    multi.add(0x311, 0);
+    multi.add(0x411, 1);
+    multi.add(0x522, 2);
+    multi.build();
+    EXPECT_EQ(true, multi.find(0, 0x11).empty());
+    EXPECT_EQ(1, multi.find(0, 0x22).size());
+    EXPECT_EQ(1, multi.nmasked());
+}
+
+TEST(seed_index, save_map) {
+    const char *path = "seed_index_test.sds";
+    seed_index idx[2], mapped[2];
+    idx[1].set_mask(0xFF);
+    for (int d = 0; d < 2; ++d) {
+        for (int i = 0; i < 100; ++i) idx[d].add((i * 37) & 0xFF, i);
+        idx[d].build();
+        FILE *fp = fopen(path, "wb");
+        ASSERT_TRUE(fp != NULL);
+        EXPECT_EQ(true, idx[d].save(fp, 100));
+        fclose(fp);
+        const seed_file_header *h = seed_file_map(path, SEED_FILE_INDEX);
+        ASSERT_TRUE(h != NULL);
+        EXPECT_EQ(100u, h->param[2]);
+        EXPECT_EQ(true, mapped[d].map(h));
+        EXPECT_EQ(true, mapped[d].is_mapped());
+        EXPECT_EQ(d == 1, mapped[d].is_direct());
+        EXPECT_EQ(idx[d].size(), mapped[d].size());
+        EXPECT_EQ(idx[d].npos(), mapped[d].npos());
+        for (t_seed sd = 0; sd < 0x100; ++sd) {
+            seed_span a = idx[d].find(sd), b = mapped[d].find(sd);
+            ASSERT_EQ(a.size(), b.size());
+            for (size_t k = 0; k < a.size(); ++k)
+                EXPECT_EQ(a.begin()[k], b.begin()[k]);
+        }
+        EXPECT_EQ(NULL, seed_file_map(path, SEED_FILE_PROBES));
+        mapped[d].clear();
+        EXPECT_EQ(false, mapped[d].is_mapped());
+        EXPECT_EQ(0u, mapped[d].npos());
+    }
+    unlink(path);
+}
+
+TEST(seed_index, minimizers) {
+    const int n = 200, w = 8;
+    t_seed sds[n], rev[n];
+    t_seed x = 7;
+    for (int i = 0; i < n; ++i) {
+        x = x * 1103515245u + 12345u;
+        sds[i] = i % 50 == 3 ? 0 : x;
+        rev[n-1-i] = sds[i];
+    }
+    std::vector<char> keep, rkeep, part;
+    sample_minimizers(sds, n, ~(t_seed)0, w, keep);
+    sample_minimizers(rev, n, ~(t_seed)0, w, rkeep);
+    int nkept = 0;
+    for (int i = 0; i < n; ++i) {
+        // the same ones whichever direction, never a seed 0
+        EXPECT_EQ(keep[i], rkeep[n-1-i]);
+        if (sds[i] == 0) EXPECT_EQ(0, keep[i]);
+        nkept += keep[i];
+    }
+    EXPECT_GT(n / 2, nkept);
+    // a run sharing w windows keeps one at the same place
+    for (int off = 0; off + w <= n; off += 13) {
+        sample_minimizers(sds + off, w, ~(t_seed)0, w, part);
+        bool shared = false;
+        for (int i = 0; i < w; ++i) shared |= part[i] && keep[off+i];
+        EXPECT_EQ(true, shared);
+    }
+    // every window kept without sampling
+    sample_minimizers(sds, n, ~(t_seed)0, 0, keep);
+    EXPECT_EQ(1, keep[0]);
+    EXPECT_EQ(0, keep[3]);
+
+    seed_index idx;
+    idx.window = w;
+    idx.add_run(sds, n, 0, 1);
+    idx.build();
+    EXPECT_EQ(true, idx.sampled());
+    EXPECT_EQ((size_t)nkept, idx.npos());
+}
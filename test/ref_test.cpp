@@ -117,15 +117,14 @@ TEST_F(ref_test, basic) {
     }
 
     // test get_seedmap
-    hash_table seedmap;
+    seed_index seedmap;
     pref->get_seedmap(seedmap, 0xFFFFFFFF);
     // -1 for the tailing sequence with all A
     EXPECT_EQ(sz-15-1, seedmap.size());
     for (int i = 0; i < sz-16; ++i) {
-        EXPECT_EQ(true, seedmap.find(dna_seq::encode(dna_txt+i)) 
-                != seedmap.end());
+        EXPECT_EQ(false, seedmap.find(dna_seq::encode(dna_txt+i)).empty());
     }
-    EXPECT_EQ(true, seedmap.find(dna_seq::encode(dna_txt+sz-15)) == seedmap.end());
+    EXPECT_EQ(true, seedmap.find(dna_seq::encode(dna_txt+sz-15)).empty());
 }
 
 TEST_F(ref_test, grow) { 
@@ -252,3 +251,144 @@ TEST_F(ref_test, prepend) {
     for (int i = sz7-1; i >= 0; --i) 
         EXPECT_EQ(dna_txt7[i], bac_seg7.next());
 }
+
+TEST(ref_seq, patch_seedmap) {
+    static char txt[30000];
+    unsigned x = 7;
+    for (int i = 0; i < 30000; ++i) {
+        x = x * 1103515245 + 12345;
+        int c = (x >> 16) & 3;
+        txt[i] = I2C(c);
+    }
+    // repeats in the head, across its end, and in the tail, and one that
+    // the prepended bases extend to the front
+    memcpy(txt + 19900, txt + 100, 300);
+    memcpy(txt + 27000, txt + 100, 300);
+    memcpy(txt, txt + 1010, 300);
+    char pre_txt[10];
+    ref_seq ref(txt, 30000, false);
+    t_seed pats[2] = {0xFF3C3FFC, 0xFFFFFFFF};
+    seed_index inc[2];
+    for (int k = 0; k < 2; ++k) ref.get_seedmap(inc[k], pats[k]);
+
+    for (int round = 0; round < 2; ++round) {
+        edit sub[1] = {{MATCH, 'A'}};
+        edit del[1] = {{DELETE, 0}};
+        edit ins[2] = {{MATCH, 0}, {INSERT, 'C'}};
+        for (int v = 0; v < 2; ++v) {
+            sub[0].val = ref.get_accessor(5000, true).at(0) == 'A' ? 'C' : 'A';
+            ref.elect(5000, sub, 1, true);
+            ref.elect(29000, sub, 1, true);
+            ref.elect(12000 + round, del, 1, true);
+            ins[0].val = ref.get_accessor(25000, true).at(0);
+            ref.elect(25000, ins, 2, true);
+        }
+        memcpy(pre_txt, ref.get_accessor(1000, true).pt(0), 10);
+        ref.prepend(pre_txt, 10);
+        ref.append((char *)"TTGCA", 5);
+        ref.evolve();
+
+        int len = ref.length();
+        seq_accessor ac = ref.get_accessor(0, true);
+        for (int k = 0; k < 2; ++k) {
+            seed_index full;
+            ref.get_seedmap(inc[k], pats[k]);
+            full.set_mask(pats[k]);
+            for (int i = 0; i < std::min(len - 16, MAX_READ_LEN); ++i)
+                if (dna_seq::encode(ac.pt(i)) & pats[k])
+                    full.add(dna_seq::encode(ac.pt(i)) & pats[k], i);
+            for (int i = len - 16; i > std::max(MAX_READ_LEN, len - 16 - 
+                        MAX_READ_LEN); --i)
+                if (dna_seq::encode(ac.pt(i)) & pats[k])
+                    full.add(dna_seq::encode(ac.pt(i)) & pats[k], i);
+            full.build();
+            EXPECT_EQ(full.npos(), inc[k].npos());
+            EXPECT_EQ(full.size(), inc[k].size());
+            for (int i = 0; i <= len - 16; ++i) {
+                t_seed sd = dna_seq::encode(ac.pt(i)) & pats[k];
+                seed_span a = full.find(sd), b = inc[k].find(sd);
+                ASSERT_EQ(a.size(), b.size());
+                for (size_t h = 0; h < a.size(); ++h)
+                    ASSERT_EQ(a.begin()[h], b.begin()[h]);
+            }
+        }
+    }
+}
+
+TEST(ref_seq, batch_votes) {
+    // votes cast one alignment at a time and in batch evolve the same
+    static char txt[5000];
+    unsigned x = 11;
+    for (int i = 0; i < 5000; ++i) {
+        x = x * 1103515245 + 12345;
+        txt[i] = I2C((x >> 16) & 3);
+    }
+    ref_seq now(txt, 5000, false), later(txt, 5000, false);
+    later.batch_votes(true);
+    std::vector<edit> edits;
+    for (int round = 0; round < 3; ++round) {
+        int front = 0;
+        for (int a = 0; a < 400; ++a) {
+            x = x * 1103515245 + 12345;
+            int len = 1 + (x >> 16) % 300;
+            bool forward = (x >> 8) & 1;
+            int n = now.length() - front;
+            // some from the front, with INSERTs before it
+            bool at_front = a % 5 == 0;
+            int pos = front + (at_front ? 0 : (x >> 4) % (n-len));
+            if (!forward) pos += len-1;
+            seq_accessor ac = now.get_accessor(pos, forward);
+            edits.clear();
+            for (int k = 0; k < len; ) {
+                x = x * 1103515245 + 12345;
+                int r = (x >> 16) % 100;
+                edit e = {MATCH, ac.at(k)};
+                if (r < 20 && (k > 0 || (at_front && forward))) 
+                    e.op = INSERT;
+                else if (r < 30) 
+                    e.op = DELETE;
+                if (e.op == INSERT || r < 40) e.val = I2C((x >> 8) & 3);
+                if (e.op != INSERT) ++k;
+                edits.push_back(e);
+            }
+            if (at_front && !forward) {
+                edit e = {INSERT, 'G'};
+                edits.push_back(e);
+            }
+            now.elect(pos, &edits[0], edits.size(), forward);
+            later.elect(pos, &edits[0], edits.size(), forward);
+            if (a % 50 == 49) {
+                now.prepend((char *)"ACGTT", 5);
+                later.prepend((char *)"ACGTT", 5);
+                now.append((char *)"TTGCA", 5);
+                later.append((char *)"TTGCA", 5);
+                front -= 5;
+            }
+        }
+        now.evolve();
+        later.evolve();
+        ASSERT_EQ(now.length(), later.length());
+        EXPECT_EQ(0, strncmp(now.get_accessor(0, true).pt(0), 
+                    later.get_accessor(0, true).pt(0), now.length()));
+    }
+}
+
+TEST(ref_seq, grow_both_ends) {
+    // past MAX_SEQ_LEN at both ends, across evolve
+    char seg[1000];
+    for (int i = 0; i < 1000; ++i) seg[i] = codes[i % 7 % 4];
+    ref_seq ref(seg, 100, false);
+    std::string txt(seg, 100);
+    for (int round = 0; round < 2; ++round) {
+        for (int k = 0; k < MAX_SEQ_LEN / 1000 + 1; ++k) {
+            ref.append(seg + k % 10, 990);
+            txt.append(seg + k % 10, 990);
+            ref.prepend(seg + k % 3, 997);
+            txt.insert(0, seg + k % 3, 997);
+        }
+        ref.evolve();
+        ASSERT_EQ(txt.length(), ref.length());
+        EXPECT_EQ(0, txt.compare(0, txt.length(), 
+                    ref.get_accessor(0, true).pt(0), ref.length()));
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * ===========================================================================
+ *
+ *       Filename:  seed64_test.cpp
+ *         Author:  Ming Chen, brianchenming@gmail.com
+ *        Created:  10/17/2026 03:12:48 PM
+ *
+ *    Description:  test seeds of 32 bases, built with SEED_BITS 64
+ *
+ *       Revision:  none
+ *
+ * ===========================================================================
+ */
+
+#undef SEED_BITS
+#define SEED_BITS 64
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <dna_seq.h>
+#include <seed_index.h>
+#include <seq_aligner.h>
+
+char dna64_str[] = "ACGTGTCATCGGATCAACCGGTTAGCATTGCAGGTCAACTGTTACGA";
+
+TEST(seed64, encode) {
+    EXPECT_EQ(8u, sizeof(t_seed));
+    EXPECT_EQ(32, N_SEQ_WORD);
+    char txt_buf[N_SEQ_WORD+1] = "";
+    dna_seq::decode(dna_seq::encode(dna64_str+3), txt_buf);
+    EXPECT_EQ(0, strncmp(dna64_str+3, txt_buf, N_SEQ_WORD));
+    // 32 T's of a pattern, any A after them is ignored
+    EXPECT_EQ(~(t_seed)0, dna_seq::encode("TTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTTA"));
+    EXPECT_EQ(0xC0ull << 56, dna_seq::encode("AAAAAAAAAAAAAAAAAAAAAAAAAAAATAAA"));
+
+    int len = strlen(dna64_str), n = len - N_SEQ_WORD + 1;
+    unsigned char bin_buf[64];
+    t_seed seeds[64];
+    dna_seq::text2bin(dna64_str, bin_buf, sizeof(bin_buf));
+    EXPECT_EQ(n, dna_seq::seeds(bin_buf, seeds));
+    fwd_txt_seeds ft(txt_bases(dna64_str), 0);
+    rev_bin_seeds rb(bin_bases(bin_buf), n-1);
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(dna_seq::encode(dna64_str+i), dna_seq::seed_at(bin_buf, i));
+        EXPECT_EQ(dna_seq::encode(dna64_str+i), seeds[i]);
+        EXPECT_EQ(dna_seq::encode(dna64_str+i), ft.next());
+        EXPECT_EQ(dna_seq::encode(dna64_str+n-1-i), rb.next());
+    }
+}
+
+TEST(seed64, index) {
+    // weight 22 in the high half: direct; weight 34: hashed
+    t_seed light = 0xFC3CF0FF00000000ull, heavy = 0xFC3CF0FFFF3C0000ull;
+    seed_index direct, hashed, table;
+    direct.set_mask(light);
+    table.set_mask(light);
+    table.pext = false;
+    hashed.set_mask(heavy);
+    EXPECT_EQ(true, direct.is_direct());
+    EXPECT_EQ(false, hashed.is_direct());
+    EXPECT_EQ(0x3FFFFFull, direct.compact(light));
+    EXPECT_EQ(0x3FFFFFull, table.compact(light));
+    t_seed x = 1;
+    for (int i = 0; i < 5000; ++i) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        t_seed sd = x & 0xF0F0F0F0F0F0F0F0ull;
+        direct.add(sd & light, i);
+        table.add(sd & light, i);
+        hashed.add(sd & heavy, i);
+    }
+    direct.build();
+    table.build();
+    hashed.build();
+    x = 1;
+    for (int i = 0; i < 5000; ++i) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        t_seed sd = x & 0xF0F0F0F0F0F0F0F0ull;
+        seed_span a = direct.find(sd & light), b = table.find(sd & light);
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t k = 0; k < a.size(); ++k)
+            EXPECT_EQ(a.begin()[k], b.begin()[k]);
+        seed_span h = hashed.find(sd & heavy);
+        EXPECT_NE(h.end(), std::find(h.begin(), h.end(), i));
+    }
+    EXPECT_EQ(true, direct.find(0x1).empty());
+}
+
+TEST(seed64, chained) {
+    // 10 kb with ~6% errors, chained by seeds of 32 bases
+    std::string ref_str, seg_str;
+    srand(7);
+    for (int i = 0; i < 10000; ++i) {
+        char c = codes[rand() & 0x3];
+        int r = rand() % 100;
+        ref_str += c;
+        if (r < 2) continue;
+        if (r < 4) seg_str += codes[rand() & 0x3];
+        seg_str += r >= 4 && r < 6 ? codes[(C2I(c)+1) & 0x3] : c;
+    }
+    t_seed sd_pat = dna_seq::encode("TTTAATTTATTATTTTTTATTATATTAATTTT");
+    t_aligner chained;
+    seq_accessor ref((char*)ref_str.c_str(), true, ref_str.length());
+    seq_accessor seg((char*)seg_str.c_str(), true, seg_str.length());
+    EXPECT_LT(0, chained.align_chained(&seg, &ref, sd_pat));
+    EXPECT_LT(20, chained.nanchor);
+    EXPECT_LT(seg_str.length() * 0.99, chained.matlen_a);
+}